@@ -0,0 +1,261 @@
+#include "crc32.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#define CRC32_ARM
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+typedef uint32_t (*crc32_fn)(uint32_t crc, const uint8_t * p, size_t size);
+
+// Slicing-by-8: table k holds the CRC of a byte followed by k zero bytes, so
+// eight bytes can be folded in with eight independent lookups
+static uint32_t crc32_table[8][256];
+static volatile bool crc32_ready = false;
+
+static void crc32_init()
+{
+  uint32_t i, j;
+
+  for(i = 0; i < 256; i++) {
+    uint32_t c = i;
+
+    for(j = 0; j < 8; j++)
+      c = (c >> 1) ^ (0xEDB88320 & -(c & 1));
+
+    crc32_table[0][i] = c;
+  }
+
+  for(i = 0; i < 256; i++)
+    for(j = 1; j < 8; j++)
+      crc32_table[j][i] = (crc32_table[j-1][i] >> 8) ^ crc32_table[0][crc32_table[j-1][i] & 0xff];
+
+  // racing threads just compute the same tables twice, but nobody may see the
+  // flag before the tables
+  __sync_synchronize();
+  crc32_ready = true;
+}
+
+// All of these work on the inverted crc
+static uint32_t crc32_bytes(uint32_t crc, const uint8_t * p, size_t size)
+{
+  while(size--)
+    crc = crc32_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+  return crc;
+}
+
+static uint32_t crc32_slice8(uint32_t crc, const uint8_t * p, size_t size)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while(size >= 8) {
+    uint32_t lo, hi;
+
+    memcpy(&lo, p, 4);
+    memcpy(&hi, p+4, 4);
+    lo ^= crc;
+
+    crc = crc32_table[7][lo & 0xff] ^
+      crc32_table[6][(lo >> 8) & 0xff] ^
+      crc32_table[5][(lo >> 16) & 0xff] ^
+      crc32_table[4][lo >> 24] ^
+      crc32_table[3][hi & 0xff] ^
+      crc32_table[2][(hi >> 8) & 0xff] ^
+      crc32_table[1][(hi >> 16) & 0xff] ^
+      crc32_table[0][hi >> 24];
+
+    p += 8;
+    size -= 8;
+  }
+#endif
+
+  return crc32_bytes(crc, p, size);
+}
+
+#ifdef CRC32_X86
+// Folds 64 bytes at a time with carry-less multiplies, then reduces the
+// remaining 128 bits with Barrett reduction, as in Intel's "Fast CRC
+// Computation for Generic Polynomials Using PCLMULQDQ Instruction". The
+// constants are those of the bit-reflected zlib polynomial.
+__attribute__((target("pclmul,sse2")))
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t * p, size_t size)
+{
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+  const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+  const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+  __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+  if(size < 64)
+    return crc32_slice8(crc, p, size);
+
+  x1 = _mm_loadu_si128((const __m128i *)(p+0x00));
+  x2 = _mm_loadu_si128((const __m128i *)(p+0x10));
+  x3 = _mm_loadu_si128((const __m128i *)(p+0x20));
+  x4 = _mm_loadu_si128((const __m128i *)(p+0x30));
+
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+
+  p += 64;
+  size -= 64;
+
+  // four independent 128 bit lanes keep the multipliers busy
+  while(size >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)(p+0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(p+0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(p+0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(p+0x30)));
+
+    p += 64;
+    size -= 64;
+  }
+
+  // fold the four lanes into one
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  while(size >= 16) {
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i *)p)), x5);
+
+    p += 16;
+    size -= 16;
+  }
+
+  // 128 bits down to 64
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // and Barrett reduction to 32
+  x2 = _mm_and_si128(x1, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+  x2 = _mm_and_si128(x2, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  crc = _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+
+  return crc32_slice8(crc, p, size);
+}
+#endif
+
+#ifdef CRC32_ARM
+// ARMv8's CRC32 instructions implement the zlib polynomial directly
+__attribute__((target("+crc")))
+static uint32_t crc32_arm(uint32_t crc, const uint8_t * p, size_t size)
+{
+  while(size > 0 && ((uintptr_t)p & 7)) {
+    crc = __crc32b(crc, *p++);
+    size--;
+  }
+
+  while(size >= 8) {
+    uint64_t v;
+
+    memcpy(&v, p, 8);
+    crc = __crc32d(crc, v);
+    p += 8;
+    size -= 8;
+  }
+
+  while(size--)
+    crc = __crc32b(crc, *p++);
+
+  return crc;
+}
+#endif
+
+struct crc32_variant
+{
+  const char * name;
+  crc32_fn fn;
+};
+
+static const struct crc32_variant variants[] = {
+  {"slice-by-8", crc32_slice8},
+#ifdef CRC32_X86
+  {"pclmul", crc32_pclmul},
+#endif
+#ifdef CRC32_ARM
+  {"armv8-crc", crc32_arm},
+#endif
+};
+
+static const struct crc32_variant * volatile variant = NULL;
+
+static const struct crc32_variant * crc32_pick()
+{
+#ifdef CRC32_X86
+  __builtin_cpu_init();
+
+  if(__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2"))
+    return &variants[1];
+#endif
+
+#ifdef CRC32_ARM
+  if(getauxval(AT_HWCAP) & HWCAP_CRC32)
+    return &variants[1];
+#endif
+
+  return &variants[0];
+}
+
+// racing threads all pick the same one
+static inline const struct crc32_variant * crc32_variant()
+{
+  const struct crc32_variant * v = variant;
+
+  if(!v) {
+    if(!crc32_ready)
+      crc32_init();
+
+    variant = v = crc32_pick();
+  }
+
+  return v;
+}
+
+uint32_t crc32_update(uint32_t crc, const void * data, size_t size)
+{
+  return ~crc32_variant()->fn(~crc, data, size);
+}
+
+const char * crc32_implementation()
+{
+  return crc32_variant()->name;
+}
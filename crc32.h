@@ -0,0 +1,17 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// The standard (zlib/PKZIP) CRC-32. Start with a crc of 0 and feed the
+// previous result back in to checksum data in pieces.
+//
+// Uses carry-less multiplication (PCLMULQDQ) or the ARMv8 CRC instructions
+// when the CPU has them, slicing-by-8 tables otherwise.
+uint32_t crc32_update(uint32_t crc, const void * data, size_t size);
+
+// Name of the implementation crc32_update uses on this CPU
+const char * crc32_implementation();
+
+#endif
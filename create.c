@@ -0,0 +1,925 @@
+#include "create.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "minilzo.h"
+#include "lzo1x_opt.h"
+#include "lzo1x_fast.h"
+#include "util.h"
+#include "fs.h"
+#include "pool.h"
+#include "pack.h"
+#include "index.h"
+#include "crc32.h"
+#include "uring.h"
+
+// Files are read and compressed in batches of at most this many entries or
+// input bytes. The workers fill one batch while the previous one is written.
+#define CREATE_BATCH_ENTRIES 64
+#define CREATE_BATCH_BYTES (32*1024*1024)
+
+// Worst case LZO1X output for `n` input bytes, plus the object header
+#define LZO_OBJECT_BOUND(n) (LZO_OBJECT_HEADER_SIZE + (n) + (n)/16 + 64 + 3)
+
+// Objects that don't shrink by at least 1/CREATE_STORE_RATIO of their size
+// are stored. Copying them out is so much cheaper than decoding them that the
+// few bytes saved aren't worth it.
+#define CREATE_STORE_RATIO 32
+
+// How much of a file is looked at before deciding whether it is worth
+// compressing at all. Files up to this size are simply compressed.
+#define CREATE_SAMPLE_SIZE (64*1024)
+
+// Samples with fewer bits of entropy per byte than this compress well enough
+// without a trial. Above CREATE_RANDOM_ENTROPY they look compressed or
+// encrypted already, though repeating patterns can score just as high, so
+// the trial has the last word.
+#define CREATE_COMPRESS_ENTROPY 6.0
+#define CREATE_RANDOM_ENTROPY 7.8
+
+// An entry of the new pack. It comes from a file or, when optimizing, from
+// an entry of the old pack.
+struct create_input
+{
+  char * path;
+  char * name;
+  size_t size;
+  uint32_t unk1, unk3;
+  const struct pack_index_entry * entry;
+};
+
+// Where an item is in its io_uring read
+enum create_read_state
+{
+  CREATE_OPENING,
+  CREATE_READING,
+  CREATE_CLOSING
+};
+
+struct create_item
+{
+  struct create_input * input;
+  struct scratch data;   // the file contents
+  struct scratch object; // header and payload as written to the pack
+  size_t objectSize;
+  uint32_t crc;
+  const char * storeReason; // why the data was stored without trying to compress it
+  bool loaded;           // the file was read into `data` already
+  uint64_t offset;       // of the object in the temporary file
+
+  // the io_uring operation in flight for the item
+  enum create_read_state state;
+  int fd;
+  size_t done;
+};
+
+struct create_worker
+{
+  struct scratch wrkmem;
+  struct scratch check; // decoded again when verifying
+  struct lzo1x_opt * opt;
+  struct pack_cursor cursor;
+};
+
+struct create_job
+{
+  const struct create_options * opts;
+  struct create_input * inputs;
+  size_t numInputs;
+  struct create_worker * workers;
+  unsigned numWorkers;
+
+  // the pack being optimized
+  struct pack_reader * reader;
+  uint64_t startOfEntries;
+
+  // every entry object is appended here until the index size is known
+  int tmpFd;
+  uint64_t written;
+  size_t stored; // objects that are not compressed
+
+  // the decompressed index, grown as entries are written
+  uint8_t * index;
+  size_t indexSize;
+  size_t indexAlloc;
+
+#ifdef HAVE_URING
+  // Files are read on the main thread and objects written on the writer
+  // thread, each through a ring of its own
+  bool useUring;
+  struct uring readRing;
+  struct uring writeRing;
+#endif
+};
+
+struct create_batch
+{
+  struct create_job * job;
+  struct create_item items[CREATE_BATCH_ENTRIES];
+  size_t count;
+};
+
+static int compare_inputs(const void * a, const void * b)
+{
+  const struct create_input * l = a;
+  const struct create_input * r = b;
+
+  return strcmp(l->name, r->name);
+}
+
+// Formats that are compressed already. LZO1X gets next to nothing out of them.
+struct create_format
+{
+  const char * name;
+  const char * magic;
+  size_t size;
+};
+
+static const struct create_format compressedFormats[] = {
+  {"JPEG", "\xff\xd8\xff", 3},
+  {"PNG", "\x89PNG", 4},
+  {"Ogg", "OggS", 4},
+  {"ZIP", "PK\x03\x04", 4},
+  {"gzip", "\x1f\x8b", 2},
+  {"Bink", "BIK", 3},
+  {"MP3", "ID3", 3},
+};
+
+// DDS textures are only compressed when their pixel format names a block
+// compression FourCC, plain RGB(A) ones compress well
+#define DDS_PIXEL_FLAGS_OFFSET 80
+#define DDS_FOURCC_OFFSET 84
+#define DDS_PF_FOURCC 0x4
+
+static const char * create_known_format(const uint8_t * data, size_t size)
+{
+  size_t i;
+
+  for(i = 0; i < sizeof(compressedFormats)/sizeof(*compressedFormats); i++) {
+    const struct create_format * f = &compressedFormats[i];
+
+    if(size >= f->size && memcmp(data, f->magic, f->size) == 0)
+      return f->name;
+  }
+
+  if(size >= DDS_FOURCC_OFFSET+4 && memcmp(data, "DDS ", 4) == 0) {
+    uint32_t flags;
+
+    memcpy(&flags, data+DDS_PIXEL_FLAGS_OFFSET, sizeof(flags));
+    const uint8_t * fourcc = data+DDS_FOURCC_OFFSET;
+
+    if((flags & DDS_PF_FOURCC) && (memcmp(fourcc, "DXT", 3) == 0 ||
+        memcmp(fourcc, "ATI", 3) == 0 || memcmp(fourcc, "BC", 2) == 0)) {
+      return "DDS";
+    }
+  }
+
+  return NULL;
+}
+
+// Shannon entropy of the byte values in `data`, in bits per byte
+static double create_entropy(const uint8_t * data, size_t size)
+{
+  size_t counts[256] = {0};
+  double entropy = 0;
+  size_t i;
+
+  for(i = 0; i < size; i++)
+    counts[data[i]]++;
+
+  for(i = 0; i < 256; i++) {
+    if(counts[i]) {
+      double p = (double)counts[i]/size;
+      entropy -= p*log2(p);
+    }
+  }
+
+  return entropy;
+}
+
+// Returns why `data` isn't worth compressing, or NULL when it is. The first
+// CREATE_SAMPLE_SIZE bytes are compressed to `trial` when their entropy alone
+// doesn't settle it, which must hold LZO_OBJECT_BOUND(size) bytes.
+static const char * create_store_reason(const uint8_t * data, size_t size, uint8_t * trial,
+    struct create_worker * w)
+{
+  const char * format = create_known_format(data, size);
+  size_t trialLen = 0;
+
+  if(format)
+    return format;
+
+  // small files cost no more to compress than to sample
+  if(size <= CREATE_SAMPLE_SIZE)
+    return NULL;
+
+  double entropy = create_entropy(data, CREATE_SAMPLE_SIZE);
+
+  if(entropy < CREATE_COMPRESS_ENTROPY)
+    return NULL;
+
+  // The greedy compressor gives a good idea of how well the rest would
+  // compress long before the optimizing one would be done with all of it
+  if(lzo1x_fast_compress(data, CREATE_SAMPLE_SIZE, trial, &trialLen, LZO1X_FAST_HASH_BITS,
+      scratch_reserve(&w->wrkmem, LZO1X_FAST_MEM_COMPRESS(LZO1X_FAST_HASH_BITS))) == LZO_E_OK &&
+      trialLen+CREATE_SAMPLE_SIZE/CREATE_STORE_RATIO < CREATE_SAMPLE_SIZE) {
+    return NULL;
+  }
+
+  return entropy > CREATE_RANDOM_ENTROPY ? "high entropy" : "trial compression";
+}
+
+// Compresses `size` bytes of `data` into a complete object at `out`, which
+// must hold LZO_OBJECT_BOUND(size) bytes. Data that barely shrinks is stored,
+// and so is everything when `store` is set.
+static size_t create_object(const uint8_t * data, size_t size, uint32_t crc,
+    uint8_t * out, struct create_worker * w, unsigned level, bool verify, bool store)
+{
+  uint8_t * payload = out+LZO_OBJECT_HEADER_SIZE;
+  size_t outLen = 0;
+  int res = LZO_E_OK;
+
+  if(store) {
+    outLen = size;
+  } else if(level >= LZO1X_OPT_MIN_LEVEL) {
+    if(!w->opt && !(w->opt = lzo1x_opt_alloc())) {
+      fatal("failed to allocate compression memory");
+    }
+
+    res = lzo1x_opt_compress(data, size, payload, &outLen, level, w->opt);
+  } else {
+    res = lzo1x_fast_compress(data, size, payload, &outLen, LZO1X_FAST_HASH_BITS,
+        scratch_reserve(&w->wrkmem, LZO1X_FAST_MEM_COMPRESS(LZO1X_FAST_HASH_BITS)));
+  }
+
+  // Make sure the strict decoder gets the data back before trusting the output
+  if(verify && res == LZO_E_OK && outLen < size) {
+    lzo_uint checkLen = size;
+    uint8_t * check = scratch_reserve(&w->check, size);
+
+    if(lzo1x_decompress_safe(payload, outLen, check, &checkLen, NULL) != LZO_E_OK ||
+        checkLen != size || memcmp(check, data, size) != 0) {
+      fatal("compressed data failed to verify");
+    }
+  }
+
+  if(res != LZO_E_OK || outLen+size/CREATE_STORE_RATIO >= size) {
+    memcpy(payload, data, size);
+    outLen = size;
+  }
+
+  lzo_object_write_header(out, size, crc, outLen == size);
+
+  return LZO_OBJECT_HEADER_SIZE+outLen;
+}
+
+static bool read_file(const char * path, uint8_t * data, size_t size)
+{
+  FILE * fp = fopen(path, "rb");
+
+  if(!fp)
+    return false;
+
+  bool ok = fread(data, 1, size, fp) == size;
+
+  fclose(fp);
+
+  return ok;
+}
+
+// Decodes an entry of the pack being optimized into `data`, taking its CRC on
+// the way. Returns the original object, which stays valid until it is
+// released.
+static const uint8_t * read_entry(struct create_job * job, struct pack_cursor * c,
+    const struct create_input * input, uint8_t * data, uint32_t * crc)
+{
+  const struct pack_index_entry * e = input->entry;
+  const uint8_t * object = pack_cursor_fetch(c, job->startOfEntries+e->offset, e->compressedSize);
+  struct lzo_object obj;
+  size_t size = 0;
+
+  if(!object || !lzo_object_parse(object, e->compressedSize, &obj) ||
+      obj.decompressedSize != input->size ||
+      lzo_object_decode(&obj, data, &size, crc) != LZO_E_OK || size != input->size) {
+    fatal("failed to unpack file %s", input->name);
+  }
+
+  return object;
+}
+
+static void create_item(void * ctx, unsigned worker, size_t item)
+{
+  struct create_batch * batch = ctx;
+  struct create_job * job = batch->job;
+  struct create_worker * w = &job->workers[worker];
+  struct create_item * it = &batch->items[item];
+  size_t size = it->input->size;
+  const uint8_t * original = NULL;
+
+  it->objectSize = 0;
+  it->crc = 0;
+  it->storeReason = NULL;
+
+  // empty files have no object at all
+  if(size == 0)
+    return;
+
+  uint8_t * data = scratch_reserve(&it->data, size);
+
+  if(it->input->entry) {
+    original = read_entry(job, &w->cursor, it->input, data, &it->crc);
+  } else if(it->loaded || read_file(it->input->path, data, size)) {
+    it->crc = crc32_update(0, data, size);
+  } else {
+    fatal("failed to read %s", it->input->path);
+  }
+
+  uint8_t * object = scratch_reserve(&it->object, LZO_OBJECT_BOUND(size));
+
+  it->storeReason = create_store_reason(data, size, object+LZO_OBJECT_HEADER_SIZE, w);
+  it->objectSize = create_object(data, size, it->crc, object, w, job->opts->level,
+      job->opts->verify, it->storeReason != NULL);
+
+  // Optimizing never makes an entry bigger
+  if(original) {
+    const struct pack_index_entry * e = it->input->entry;
+
+    if(it->objectSize > e->compressedSize) {
+      memcpy(it->object.data, original, e->compressedSize);
+      it->objectSize = e->compressedSize;
+      it->storeReason = NULL;
+    }
+
+    pack_cursor_release(&w->cursor, original, job->startOfEntries+e->offset, e->compressedSize);
+  }
+}
+
+static void index_append(struct create_job * job, const void * data, size_t size)
+{
+  if(job->indexSize+size > job->indexAlloc) {
+    job->indexAlloc = max(job->indexAlloc*2, job->indexSize+size);
+    job->index = realloc(job->index, job->indexAlloc);
+
+    if(!job->index) {
+      fatal("failed to allocate the pack index");
+    }
+  }
+
+  memcpy(job->index+job->indexSize, data, size);
+  job->indexSize += size;
+}
+
+#ifdef HAVE_URING
+// Every item has at most one operation in flight and the rings have an entry
+// for every item of a batch, so uring_sqe can't come back empty
+static struct io_uring_sqe * create_sqe(struct uring * u, size_t item, int opcode, int fd)
+{
+  struct io_uring_sqe * sqe = uring_sqe(u);
+
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->user_data = item;
+
+  return sqe;
+}
+
+static void create_submit(struct uring * u)
+{
+  if(uring_submit(u, 1) < 0) {
+    fatal("io_uring submission failed");
+  }
+}
+
+static void create_read_next(struct uring * u, struct create_item * it, size_t item)
+{
+  struct io_uring_sqe * sqe;
+
+  if(it->done < it->input->size) {
+    sqe = create_sqe(u, item, IORING_OP_READ, it->fd);
+    sqe->addr = (uintptr_t)(it->data.data+it->done);
+    sqe->len = min(it->input->size-it->done, 0x40000000);
+    sqe->off = it->done;
+    it->state = CREATE_READING;
+  } else {
+    create_sqe(u, item, IORING_OP_CLOSE, it->fd);
+    it->state = CREATE_CLOSING;
+  }
+}
+
+// Opens, reads and closes every file of a batch with all of them in flight at
+// once, rather than one per worker. The workers then only compress.
+static void create_read_batch_uring(struct create_job * job, struct create_batch * batch)
+{
+  struct uring * u = &job->readRing;
+  size_t busy = 0;
+  size_t i;
+
+  for(i = 0; i < batch->count; i++) {
+    struct create_item * it = &batch->items[i];
+
+    it->loaded = false;
+
+    if(it->input->size == 0)
+      continue;
+
+    scratch_reserve(&it->data, it->input->size);
+
+    struct io_uring_sqe * sqe = create_sqe(u, i, IORING_OP_OPENAT, AT_FDCWD);
+    sqe->addr = (uintptr_t)it->input->path;
+    sqe->open_flags = O_RDONLY;
+
+    it->state = CREATE_OPENING;
+    it->done = 0;
+    busy++;
+  }
+
+  while(busy > 0) {
+    create_submit(u);
+
+    struct io_uring_cqe * cqe;
+
+    while((cqe = uring_cqe(u))) {
+      struct create_item * it = &batch->items[cqe->user_data];
+      int res = cqe->res;
+
+      uring_cqe_seen(u);
+
+      if(res < 0) {
+        fatal("failed to read %s: %s", it->input->path, strerror(-res));
+      }
+
+      switch(it->state)
+      {
+      case CREATE_OPENING:
+        it->fd = res;
+        create_read_next(u, it, cqe->user_data);
+        break;
+      case CREATE_READING:
+        // the file got shorter since it was listed
+        if(res == 0) {
+          fatal("failed to read %s", it->input->path);
+        }
+
+        it->done += res;
+        create_read_next(u, it, cqe->user_data);
+        break;
+      case CREATE_CLOSING:
+        it->loaded = true;
+        busy--;
+        break;
+      }
+    }
+  }
+}
+
+static void create_write_next(struct create_job * job, struct create_item * it, size_t item)
+{
+  struct io_uring_sqe * sqe = create_sqe(&job->writeRing, item, IORING_OP_WRITE, job->tmpFd);
+
+  sqe->addr = (uintptr_t)(it->object.data+it->done);
+  sqe->len = min(it->objectSize-it->done, 0x40000000);
+  sqe->off = it->offset+it->done;
+}
+
+// Writes every object of a batch at its offset in the temporary file, with
+// all of them in flight at once
+static void create_write_batch_uring(struct create_job * job, struct create_batch * batch)
+{
+  struct uring * u = &job->writeRing;
+  size_t busy = 0;
+  size_t i;
+
+  for(i = 0; i < batch->count; i++) {
+    struct create_item * it = &batch->items[i];
+
+    if(it->objectSize == 0)
+      continue;
+
+    it->done = 0;
+    create_write_next(job, it, i);
+    busy++;
+  }
+
+  while(busy > 0) {
+    create_submit(u);
+
+    struct io_uring_cqe * cqe;
+
+    while((cqe = uring_cqe(u))) {
+      struct create_item * it = &batch->items[cqe->user_data];
+      int res = cqe->res;
+
+      uring_cqe_seen(u);
+
+      if(res <= 0) {
+        fatal("failed to write pack data%s%s", res < 0 ? ": " : "", res < 0 ? strerror(-res) : "");
+      }
+
+      it->done += res;
+
+      if(it->done < it->objectSize) {
+        create_write_next(job, it, cqe->user_data);
+      } else {
+        busy--;
+      }
+    }
+  }
+}
+#endif // HAVE_URING
+
+static void create_write_batch(void * arg)
+{
+  struct create_batch * batch = arg;
+  struct create_job * job = batch->job;
+  size_t i;
+
+  for(i = 0; i < batch->count; i++) {
+    struct create_item * it = &batch->items[i];
+    uint32_t fields[6] = {
+      it->input->unk1,
+      (uint32_t)job->written,
+      it->input->unk3,
+      (uint32_t)it->objectSize,
+      (uint32_t)it->input->size,
+      it->crc
+    };
+
+    struct lzo_object obj;
+    bool stored = it->objectSize > 0 && lzo_object_parse(it->object.data, it->objectSize, &obj) && obj.stored;
+
+    if(stored)
+      job->stored++;
+
+    if(job->opts->verbose)
+      printf("%s (%" PRIuSZT " -> %" PRIuSZT " bytes%s%s%s)\n", it->input->name,
+          it->input->size, it->objectSize, stored ? ", stored" : "",
+          it->storeReason ? ": " : "", it->storeReason ? it->storeReason : "");
+
+    index_append(job, it->input->name, strlen(it->input->name)+1);
+    index_append(job, fields, sizeof(fields));
+
+    // entry offsets are only 32 bits wide
+    if(job->written+it->objectSize > UINT32_MAX) {
+      fatal("too much data for a single pack");
+    }
+
+    it->offset = job->written;
+    job->written += it->objectSize;
+
+#ifdef HAVE_URING
+    if(job->useUring)
+      continue;
+#endif
+
+    if(!file_write_all(job->tmpFd, it->object.data, it->objectSize)) {
+      fatal("failed to write pack data");
+    }
+  }
+
+#ifdef HAVE_URING
+  if(job->useUring)
+    create_write_batch_uring(job, batch);
+#endif
+}
+
+// Collects the regular files directly inside `dir`, sorted by name
+static size_t create_collect(const char * dir, struct create_input ** inputs)
+{
+  char ** files = NULL;
+  size_t numFiles = get_files_in_dir(dir, &files);
+  struct create_input * list = calloc(numFiles ? numFiles : 1, sizeof(*list));
+  size_t num = 0;
+  size_t i;
+
+  if(!list) {
+    fatal("failed to allocate the file list");
+  }
+
+  for(i = 0; i < numFiles; i++) {
+    if(dir_exists(files[i])) {
+      warning("skipping directory %s, packs cannot hold directories", files[i]);
+      free(files[i]);
+      continue;
+    }
+
+    list[num].path = files[i];
+    list[num].name = basename(files[i], false);
+    list[num].size = file_size(files[i]);
+
+    if(list[num].size >= LZO_OBJECT_STORED) {
+      fatal("%s is too large to be packed", files[i]);
+    }
+
+    num++;
+  }
+
+  free(files);
+
+  qsort(list, num, sizeof(*list), compare_inputs);
+
+  *inputs = list;
+  return num;
+}
+
+// Compresses every input into the temporary file at `tmpPath`
+static void create_run(struct create_job * job, const char * tmpPath)
+{
+  struct create_batch * batches = calloc(2, sizeof(struct create_batch));
+  struct pool_task * writer = NULL;
+  size_t next = 0;
+  size_t i;
+  int cur = 0;
+  int b;
+
+  job->numWorkers = pool_clamp_workers(job->opts->jobs, job->numInputs);
+  job->workers = calloc(job->numWorkers, sizeof(struct create_worker));
+
+  if(!job->workers || !batches) {
+    fatal("failed to allocate workers");
+  }
+
+  if(job->reader) {
+    for(i = 0; i < job->numWorkers; i++)
+      pack_cursor_init(&job->workers[i].cursor, job->reader, NULL);
+  }
+
+  job->tmpFd = file_create(tmpPath);
+
+  if(job->tmpFd < 0) {
+    fatal("failed to create %s", tmpPath);
+  }
+
+  bool useUring = false;
+
+#ifdef HAVE_URING
+  if(job->opts->uring && uring_init(&job->readRing, CREATE_BATCH_ENTRIES)) {
+    useUring = uring_init(&job->writeRing, CREATE_BATCH_ENTRIES);
+
+    if(!useUring)
+      uring_free(&job->readRing);
+  }
+
+  job->useUring = useUring;
+#endif
+
+  if(job->opts->uring && !useUring) {
+    warning("io_uring is not available, using regular I/O");
+  }
+
+  while(next < job->numInputs) {
+    struct create_batch * batch = &batches[cur];
+    uint64_t bytes = 0;
+
+    batch->job = job;
+    batch->count = 0;
+
+    while(next < job->numInputs && batch->count < CREATE_BATCH_ENTRIES) {
+      size_t size = job->inputs[next].size;
+
+      if(batch->count > 0 && bytes+size > CREATE_BATCH_BYTES)
+        break;
+
+      batch->items[batch->count++].input = &job->inputs[next];
+      bytes += size;
+      next++;
+    }
+
+#ifdef HAVE_URING
+    // entries of the pack being optimized are read through its mapping
+    if(job->useUring && !job->reader)
+      create_read_batch_uring(job, batch);
+#endif
+
+    pool_run(job->numWorkers, batch->count, create_item, batch);
+
+    // The other batch has to be written out before it can be refilled
+    if(writer)
+      pool_wait(writer);
+
+    writer = pool_async(create_write_batch, batch);
+    cur = !cur;
+  }
+
+  if(writer)
+    pool_wait(writer);
+
+#ifdef HAVE_URING
+  if(job->useUring) {
+    uring_free(&job->readRing);
+    uring_free(&job->writeRing);
+  }
+#endif
+
+  close(job->tmpFd);
+
+  if(job->reader) {
+    for(i = 0; i < job->numWorkers; i++)
+      pack_cursor_free(&job->workers[i].cursor);
+  }
+
+  for(b = 0; b < 2; b++) {
+    for(i = 0; i < CREATE_BATCH_ENTRIES; i++) {
+      scratch_free(&batches[b].items[i].data);
+      scratch_free(&batches[b].items[i].object);
+    }
+  }
+
+  free(batches);
+}
+
+// The header and index come first, but their size is only known once every
+// entry has been compressed. Entries are therefore written to a temporary
+// file next to the pack and copied in behind the index at the end.
+static uint64_t create_write(struct create_job * job, const char * tmpPath,
+    const char * packPath, const struct pack_header * base)
+{
+  struct scratch indexObject = {NULL, 0};
+  uint32_t indexCrc = crc32_update(0, job->index, job->indexSize);
+  size_t indexObjectSize = create_object(job->index, job->indexSize, indexCrc,
+      scratch_reserve(&indexObject, LZO_OBJECT_BOUND(job->indexSize)),
+      &job->workers[0], job->opts->level, job->opts->verify, false);
+
+  struct pack_header header = *base;
+  memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+  header.compressed_index_size = indexObjectSize;
+  header.decompressed_index_size = job->indexSize;
+  header.num_files = job->numInputs;
+
+  int outFd = file_create(packPath);
+  int dataFd = file_open_read(tmpPath);
+
+  if(outFd < 0 || dataFd < 0) {
+    fatal("failed to create %s", packPath);
+  }
+
+  if(!file_write_all(outFd, &header, sizeof(header)) ||
+      !file_write_all(outFd, indexObject.data, indexObjectSize) ||
+      !file_copy(dataFd, 0, outFd, job->written)) {
+    fatal("failed to write %s", packPath);
+  }
+
+  close(dataFd);
+  close(outFd);
+  remove(tmpPath);
+
+  scratch_free(&indexObject);
+
+  return sizeof(header)+indexObjectSize+job->written;
+}
+
+static void create_free(struct create_job * job)
+{
+  size_t i;
+
+  for(i = 0; i < job->numWorkers; i++) {
+    scratch_free(&job->workers[i].wrkmem);
+    scratch_free(&job->workers[i].check);
+    lzo1x_opt_free(job->workers[i].opt);
+  }
+
+  for(i = 0; i < job->numInputs; i++) {
+    free(job->inputs[i].path);
+    free(job->inputs[i].name);
+  }
+
+  free(job->index);
+  free(job->inputs);
+  free(job->workers);
+}
+
+bool create_pack(const char * dir, const char * packPath, const struct create_options * opts)
+{
+  struct create_job job;
+  struct pack_header header;
+  char * tmpPath = string_cat(packPath, ".tmp");
+  uint64_t totalIn = 0;
+  size_t i;
+
+  memset(&job, 0, sizeof(job));
+  job.opts = opts;
+
+  if(lzo_init() != LZO_E_OK) {
+    fatal("failed to initialize LZO");
+  }
+
+  job.numInputs = create_collect(dir, &job.inputs);
+
+  if(job.numInputs == 0) {
+    warning("no files to pack in %s", dir);
+    free(job.inputs);
+    free(tmpPath);
+    return false;
+  }
+
+  create_run(&job, tmpPath);
+
+  memset(&header, 0, sizeof(header));
+  header.version = PACK_VERSION;
+
+  uint64_t packSize = create_write(&job, tmpPath, packPath, &header);
+
+  for(i = 0; i < job.numInputs; i++)
+    totalIn += job.inputs[i].size;
+
+  printf("Packed %" PRIuSZT " files into %s (%" PRIu64 " -> %" PRIu64 " bytes, %" PRIuSZT " stored)\n",
+      job.numInputs, packPath, totalIn, packSize, job.stored);
+
+  create_free(&job);
+  free(tmpPath);
+
+  return true;
+}
+
+// Recompresses every entry of a pack, keeping the order, names and header
+// fields. The new pack replaces the old one once it is complete.
+bool optimize_pack(const char * packPath, const struct create_options * opts)
+{
+  struct create_job job;
+  struct pack_reader reader;
+  struct pack_cursor cursor;
+  struct pack_header header;
+  struct pack_index index;
+  struct scratch indexData = {NULL, 0};
+  size_t indexSize = 0;
+  char * tmpPath = string_cat(packPath, ".tmp");
+  char * newPath = string_cat(packPath, ".new");
+  size_t i;
+
+  memset(&job, 0, sizeof(job));
+  job.opts = opts;
+
+  if(lzo_init() != LZO_E_OK) {
+    fatal("failed to initialize LZO");
+  }
+
+  if(!pack_reader_open(&reader, packPath)) {
+    fatal("could not open '%s' for reading", packPath);
+  }
+
+  pack_cursor_init(&cursor, &reader, reader.fp);
+
+  if(!pack_cursor_read(&cursor, 0, &header, sizeof(header)) ||
+      memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC))) {
+    fatal("%s is not a pack", packPath);
+  }
+
+  const uint8_t * object = pack_cursor_fetch(&cursor, sizeof(header), header.compressed_index_size);
+  struct lzo_object obj;
+
+  if(!object || !lzo_object_parse(object, header.compressed_index_size, &obj) ||
+      lzo_object_decode(&obj, scratch_reserve(&indexData, obj.decompressedSize), &indexSize, NULL) != LZO_E_OK ||
+      !pack_index_parse((char *)indexData.data, indexSize, &index, opts->jobs)) {
+    fatal("failed to read the index of %s", packPath);
+  }
+
+  pack_cursor_free(&cursor);
+
+  job.reader = &reader;
+  job.startOfEntries = sizeof(header)+header.compressed_index_size;
+  job.numInputs = index.numEntries;
+  job.inputs = calloc(index.numEntries ? index.numEntries : 1, sizeof(struct create_input));
+
+  if(!job.inputs) {
+    fatal("failed to allocate the file list");
+  }
+
+  for(i = 0; i < index.numEntries; i++) {
+    struct pack_index_entry * e = &index.index[i];
+
+    job.inputs[i].name = strdup(pack_index_name(&index, e));
+    job.inputs[i].size = e->compressedSize ? e->decompressedSize : 0;
+    job.inputs[i].unk1 = e->unk1;
+    job.inputs[i].unk3 = e->unk3;
+    job.inputs[i].entry = e;
+  }
+
+  create_run(&job, tmpPath);
+
+  // The old pack has to be closed before it can be replaced
+  pack_reader_close(&reader);
+
+  uint64_t packSize = create_write(&job, tmpPath, newPath, &header);
+
+#ifdef PLATFORM_WINDOWS
+  remove(packPath);
+#endif
+
+  if(rename(newPath, packPath) != 0) {
+    fatal("failed to replace %s with %s", packPath, newPath);
+  }
+
+  printf("Optimized %" PRIuSZT " files in %s (%" PRIu64 " -> %" PRIu64 " bytes, %" PRIuSZT " stored)\n",
+      job.numInputs, packPath, reader.size, packSize, job.stored);
+
+  create_free(&job);
+  pack_index_free(&index);
+  scratch_free(&indexData);
+  free(tmpPath);
+  free(newPath);
+
+  return true;
+}
@@ -0,0 +1,22 @@
+#ifndef CREATE_H
+#define CREATE_H
+
+#include <stdbool.h>
+
+struct create_options
+{
+  unsigned jobs; // worker threads, 0 for one per CPU
+  int verbose;
+  unsigned level; // 1 for lzo1x_fast, up to LZO1X_OPT_MAX_LEVEL for smaller packs
+  bool verify;    // decompress every object again before writing it
+  bool uring;     // read the files and write the objects through io_uring
+};
+
+// Levels used when none is asked for
+#define CREATE_DEFAULT_LEVEL 1
+#define OPTIMIZE_DEFAULT_LEVEL 9
+
+bool create_pack(const char * dir, const char * packPath, const struct create_options * opts);
+bool optimize_pack(const char * packPath, const struct create_options * opts);
+
+#endif
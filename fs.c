@@ -4,9 +4,25 @@
 #include <stdlib.h>
 #include <dirent.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "util.h"
 
+#ifdef PLATFORM_UNIX
+#include <sys/mman.h>
+#endif
+
+#ifdef PLATFORM_LINUX
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+#endif
+
+// chunk size used when files have to be copied through userspace
+#define FILE_COPY_CHUNK_SIZE (64*1024)
+
 #ifdef PLATFORM_WINDOWS
 
 #define WIN32_LEAN_AND_MEAN
@@ -124,6 +140,249 @@ bool is_cygwin()
 }
 #endif
 
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+// Creates (or truncates) a file for writing and returns its descriptor, or -1
+int file_create(const char * path)
+{
+  return open(path, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+}
+
+int file_open_read(const char * path)
+{
+  return open(path, O_RDONLY | O_BINARY);
+}
+
+bool file_write_all(int fd, const void * data, size_t size)
+{
+  const char * ptr = data;
+
+  while(size > 0) {
+    ssize_t amt = write(fd, ptr, size);
+
+    if(amt <= 0)
+      return false;
+
+    ptr += amt;
+    size -= amt;
+  }
+
+  return true;
+}
+
+// Lets the kernel move the bytes between the two files without them ever
+// entering userspace, appending them at out's file offset. Returns how many
+// bytes were copied, which is less than `size` when neither copy_file_range
+// nor sendfile support this pair of files (or this isn't Linux).
+size_t file_copy_kernel(int in, uint64_t offset, int out, size_t size)
+{
+#ifdef PLATFORM_LINUX
+  off_t inOffset = offset;
+  size_t left = size;
+
+#ifdef SYS_copy_file_range
+  while(left > 0) {
+    ssize_t amt = syscall(SYS_copy_file_range, in, &inOffset, out, NULL, left, 0);
+
+    if(amt <= 0)
+      break;
+
+    left -= amt;
+  }
+#endif
+
+  while(left > 0) {
+    ssize_t amt = sendfile(out, in, &inOffset, left);
+
+    if(amt <= 0)
+      break;
+
+    left -= amt;
+  }
+
+  return size-left;
+#else
+  return 0;
+#endif
+}
+
+// Copies `size` bytes at `offset` of `in` to out's file offset
+bool file_copy(int in, uint64_t offset, int out, uint64_t size)
+{
+  uint64_t done = file_copy_kernel(in, offset, out, size);
+
+  if(done == size)
+    return true;
+
+  char * chunk = malloc(FILE_COPY_CHUNK_SIZE);
+
+  if(!chunk || lseek(in, offset+done, SEEK_SET) < 0) {
+    free(chunk);
+    return false;
+  }
+
+  while(done < size) {
+    size_t amt = min(size-done, FILE_COPY_CHUNK_SIZE);
+
+    if(read(in, chunk, amt) != (ssize_t)amt || !file_write_all(out, chunk, amt))
+      break;
+
+    done += amt;
+  }
+
+  free(chunk);
+
+  return done == size;
+}
+
+
+// Grows a freshly created file to `size` bytes and maps it so it can be
+// filled in place. Returns NULL when that isn't possible, in which case the
+// caller should just write the file normally.
+void * file_map_for_write(int fd, size_t size)
+{
+#ifdef PLATFORM_UNIX
+  if(size == 0)
+    return NULL;
+
+#if defined(PLATFORM_LINUX) && defined(SYS_fallocate)
+  // reserve the blocks up front so large files don't end up fragmented. Not
+  // every filesystem supports this, ftruncate below still sets the size.
+  syscall(SYS_fallocate, fd, 0, (off_t)0, (off_t)size);
+#endif
+
+  if(ftruncate(fd, size) != 0)
+    return NULL;
+
+  void * map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  return map == MAP_FAILED ? NULL : map;
+#else
+  return NULL;
+#endif
+}
+
+void file_unmap(void * map, size_t size)
+{
+#ifdef PLATFORM_UNIX
+  munmap(map, size);
+#endif
+}
+
+// Maps a whole file read only, or reads it into memory where mapping isn't
+// possible. Returns NULL when the file can't be read. Release it with
+// file_unmap_read.
+void * file_map_read(const char * path, size_t * size)
+{
+  int fd = file_open_read(path);
+  struct stat s;
+  void * data = NULL;
+
+  if(fd < 0)
+    return NULL;
+
+  if(fstat(fd, &s) != 0 || s.st_size <= 0 || (uint64_t)s.st_size > SIZE_MAX) {
+    close(fd);
+    return NULL;
+  }
+
+  *size = s.st_size;
+
+#ifdef PLATFORM_UNIX
+  data = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+
+  if(data == MAP_FAILED)
+    data = NULL;
+#else
+  data = malloc(*size);
+
+  if(data && read(fd, data, *size) != (ssize_t)*size) {
+    free(data);
+    data = NULL;
+  }
+#endif
+
+  close(fd);
+
+  return data;
+}
+
+void file_unmap_read(void * data, size_t size)
+{
+#ifdef PLATFORM_UNIX
+  munmap(data, size);
+#else
+  free(data);
+#endif
+}
+
+// Hands out a descriptor for the real standard output and points stdout at
+// stderr, so that all of our messages stay out of data written to the former
+int file_take_stdout()
+{
+  fflush(stdout);
+
+  int fd = dup(fileno(stdout));
+
+  if(fd < 0 || dup2(fileno(stderr), fileno(stdout)) < 0)
+    return -1;
+
+#ifdef PLATFORM_WINDOWS
+  _setmode(fd, _O_BINARY);
+#endif
+
+  return fd;
+}
+
+// Reads a text file into an array of lines, skipping blank ones. Line endings
+// may be either Unix or DOS style.
+bool file_read_lines(const char * path, char *** lines, size_t * numLines)
+{
+  FILE * fp = fopen(path, "r");
+
+  if(!fp)
+    return false;
+
+  size_t allocSize = 0;
+  size_t num = 0;
+  char ** results = NULL;
+  char buf[4096];
+
+  while(fgets(buf, sizeof(buf), fp)) {
+    buf[strcspn(buf, "\r\n")] = '\0';
+
+    if(buf[0] == '\0')
+      continue;
+
+    if(num >= allocSize) {
+      allocSize += 20;
+      results = realloc(results, allocSize*sizeof(char*));
+    }
+
+    results[num++] = strdup(buf);
+  }
+
+  fclose(fp);
+
+  *lines = results;
+  *numLines = num;
+
+  return true;
+}
+
+// Modification time in seconds since the epoch, 0 if unknown
+uint64_t file_mtime(const char * path)
+{
+  struct stat s;
+
+  if(stat(path, &s) != 0)
+    return 0;
+
+  return s.st_mtime;
+}
+
 size_t file_size(const char * path)
 {
   FILE * fp = fopen(path, "r");
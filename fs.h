@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 
 #include "compat.h"
 
@@ -16,6 +17,7 @@
 bool file_exists(const char * path);
 bool dir_exists(const char * path);
 size_t file_size(const char * path);
+uint64_t file_mtime(const char * path);
 bool is_terminal(FILE * fp);
 bool is_cygwin();
 bool create_dir(const char * dir);
@@ -23,5 +25,16 @@ char * path_cat(const char * path1, const char * path2);
 bool path_single_level(const char * path);
 size_t get_files_in_dir(const char * name, char ** files[]);
 size_t get_files_in_dir_with_ext(const char * name, char ** files[], const char * ext);
+int file_create(const char * path);
+int file_open_read(const char * path);
+bool file_write_all(int fd, const void * data, size_t size);
+int file_take_stdout();
+bool file_read_lines(const char * path, char *** lines, size_t * numLines);
+size_t file_copy_kernel(int in, uint64_t offset, int out, size_t size);
+bool file_copy(int in, uint64_t offset, int out, uint64_t size);
+void * file_map_for_write(int fd, size_t size);
+void file_unmap(void * map, size_t size);
+void * file_map_read(const char * path, size_t * size);
+void file_unmap_read(void * data, size_t size);
 
 #endif
@@ -1,94 +1,530 @@
 #include "index.h"
 
 #include <assert.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
-bool pack_index_parse(char * indexData, size_t indexSize, struct pack_index * index)
+#include "util.h"
+#include "pool.h"
+#include "fs.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Entries ahead of the one being inserted whose slots are prefetched
+#define PACK_INDEX_PREFETCH 16
+
+// Indexes with fewer entries than this are parsed on the calling thread,
+// bigger ones in chunks of this many entries across all CPUs
+#define PACK_INDEX_CHUNK 65536
+
+// Most ranges the lookup table is split into while building it
+#define PACK_INDEX_MAX_RANGES 64
+
+// Where the entries' fields are filled in, work items are chunks of entries
+struct pack_index_fill_job
+{
+	const char * data;
+	struct pack_index_entry * entries;
+	uint32_t * starts; // where each name starts, replaced by its hash
+	size_t numEntries;
+};
+
+// Work items are ranges of the lookup table. Entries whose probe runs past
+// the end of their range are left for pack_index_build_table to insert.
+struct pack_index_table_job
+{
+	struct pack_index * index;
+	const uint32_t * hashes;
+	size_t rangeSize;
+	size_t ** deferred;
+	size_t * numDeferred;
+};
+
+static uint32_t pack_index_hash(const char * name);
+static size_t pack_index_table_size(size_t numEntries);
+static void pack_index_build_table(struct pack_index * index, const uint32_t * hashes, unsigned numWorkers);
+
+// Returns the position of the first NUL at or after `pos`, or `size` when
+// there is none. Names are short, so unlike memchr this doesn't bother to
+// align its loads first.
+static inline size_t pack_index_find_nul(const char * data, size_t pos, size_t size)
+{
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128();
+
+	while(pos+16 <= size) {
+		unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data+pos)), zero));
+
+		if(mask) {
+			return pos+__builtin_ctz(mask);
+		}
+
+		pos += 16;
+	}
+#endif
+
+	const char * end = memchr(data+pos, '\0', size-pos);
+
+	return end ? (size_t)(end-data) : size;
+}
+
+static void pack_index_fill(void * ctx, unsigned worker, size_t chunk)
+{
+	struct pack_index_fill_job * job = ctx;
+	(void)worker;
+	size_t last = min((chunk+1)*PACK_INDEX_CHUNK, job->numEntries);
+	size_t i;
+
+	for(i = chunk*PACK_INDEX_CHUNK; i < last; i++) {
+		struct pack_index_entry * entry = &job->entries[i];
+		const char * name = job->data+job->starts[i];
+		uint32_t fields[PACK_INDEX_FIELDS_SIZE/4];
+
+		memcpy(fields, name+strlen(name)+1, PACK_INDEX_FIELDS_SIZE);
+
+		entry->nameOffset = job->starts[i];
+		entry->unk1 = fields[0];
+		entry->offset = fields[1];
+		entry->unk3 = fields[2];
+		entry->compressedSize = fields[3];
+		entry->decompressedSize = fields[4];
+		entry->crc = fields[5];
+
+		// names are hashed while they are still in the cache
+		job->starts[i] = pack_index_hash(name);
+	}
+}
+
+// Parses the decompressed index. Entries refer to their names in `indexData`
+// instead of copying them, so it has to stay around until the index is freed.
+//
+// The boundaries of the entries are found first, which has to be done in
+// order, each name ending before the fields of its entry. Knowing them, the
+// entries are filled in and the lookup table is built on `jobs` workers, 0
+// meaning one per CPU.
+bool pack_index_parse(const char * indexData, size_t indexSize, struct pack_index * index, unsigned jobs)
 {
 	assert(index);
 
-	struct pack_index_entry ** entries = NULL;
-	size_t allocSize = 0;
+	// every entry takes at least a NUL and its fields, an empty index still gets one
+	size_t maxEntries = indexSize/(PACK_INDEX_FIELDS_SIZE+1);
+	uint32_t * starts = malloc(max(maxEntries, 1)*sizeof(uint32_t));
 	size_t numEntries = 0;
-
 	size_t iter = 0;
+
+	if(!starts) {
+		return false;
+	}
+
 	while(iter < indexSize) {
-		struct pack_index_entry * entry = malloc(sizeof(struct pack_index_entry));
+		size_t end = pack_index_find_nul(indexData, iter, indexSize);
+
+		// make sure the name and its fields are all there
+		if(end+1+PACK_INDEX_FIELDS_SIZE > indexSize) {
+			free(starts);
+			return false;
+		}
+
+		starts[numEntries++] = iter;
+		iter = end+1+PACK_INDEX_FIELDS_SIZE;
+	}
+
+	// everything the index keeps goes into one allocation
+	size_t tableSize = pack_index_table_size(numEntries);
+	struct pack_index_entry * entries = malloc(numEntries*sizeof(struct pack_index_entry) +
+	    tableSize*sizeof(struct pack_index_slot));
+
+	if(!entries) {
+		free(starts);
+		return false;
+	}
+
+	struct pack_index_fill_job job;
+	job.data = indexData;
+	job.entries = entries;
+	job.starts = starts;
+	job.numEntries = numEntries;
+
+	size_t numChunks = (numEntries+PACK_INDEX_CHUNK-1)/PACK_INDEX_CHUNK;
+	unsigned numWorkers = pool_clamp_workers(jobs, numChunks);
+
+	pool_run(numWorkers, numChunks, pack_index_fill, &job);
+
+	index->numEntries = numEntries;
+	index->names = indexData;
+	index->namesSize = indexSize;
+	index->index = entries;
+	index->table = (struct pack_index_slot *)(entries+numEntries);
+	index->tableMask = tableSize-1;
+	index->cache = NULL;
+	index->cacheSize = 0;
+
+	pack_index_build_table(index, starts, numWorkers);
+	free(starts);
+
+	return true;
+}
+
+void pack_index_free(struct pack_index * index)
+{
+	assert(index);
 
-		// read the name string
-		size_t nameStringLen = strlen(indexData+iter);
+	// the table lives in the same allocation
+	if(index->cache) {
+		file_unmap_read(index->cache, index->cacheSize);
+	} else {
+		free(index->index);
+	}
+
+	index->index = NULL;
+	index->table = NULL;
+	index->cache = NULL;
+	index->numEntries = 0;
+}
+
+// FNV-1a over the lower cased name, so that names differing only in case
+// end up in the same chain
+static uint32_t pack_index_hash(const char * name)
+{
+	uint32_t hash = 2166136261u;
+
+	for(; *name; name++) {
+		hash ^= (uint8_t)tolower((unsigned char)*name);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+// keep the table at most half full
+static size_t pack_index_table_size(size_t numEntries)
+{
+	size_t size = 16;
+	while(size < numEntries*2) {
+		size *= 2;
+	}
+
+	return size;
+}
 
-		// make sure the string is sane
-		if(nameStringLen+1+iter > indexSize) {
-			free(entry);
-			goto error;
+// Inserts entry `i`, unless its probe would run into `end`. Inserting is all
+// cache misses on big indexes, so the caller prefetches a few entries ahead.
+static inline bool pack_index_insert(struct pack_index * index, uint32_t hash, size_t i, size_t end)
+{
+	size_t slot = hash & index->tableMask;
+
+	while(index->table[slot].entry != 0) {
+		slot = (slot+1) & index->tableMask;
+
+		if(slot == end) {
+			return false;
 		}
+	}
 
-		entry->name = strdup(indexData+iter);
-		iter += nameStringLen+1; // skip null
+	index->table[slot].hash = hash;
+	index->table[slot].entry = i+1;
 
-		uint32_t * targets[] = {
-			&entry->unk1, &entry->offset, &entry->unk3,
-			&entry->compressedSize, &entry->decompressedSize, &entry->crc};
+	return true;
+}
 
-		size_t i;
-		for(i = 0; i < sizeof(targets)/sizeof(*targets); i++) {
-			if(iter+4 > indexSize) {
-				free(entry->name);
-				free(entry);
-				goto error;
-			}
+// Every worker goes through all hashes, in index order, and inserts those
+// that belong to its range of the table
+static void pack_index_fill_table(void * ctx, unsigned worker, size_t range)
+{
+	struct pack_index_table_job * job = ctx;
+	(void)worker;
+	struct pack_index * index = job->index;
+	size_t first = range*job->rangeSize;
+	size_t end = (first+job->rangeSize) & index->tableMask;
+	size_t alloc = 0;
+	size_t i;
+
+	job->deferred[range] = NULL;
+	job->numDeferred[range] = 0;
+
+	for(i = 0; i < index->numEntries; i++) {
+		uint32_t hash = job->hashes[i];
+
+		if(((hash & index->tableMask)-first) >= job->rangeSize) {
+			continue;
+		}
 
-			memcpy(targets[i], indexData+iter, 4);
-			iter += 4;
+		if(i+PACK_INDEX_PREFETCH < index->numEntries) {
+			__builtin_prefetch(&index->table[job->hashes[i+PACK_INDEX_PREFETCH] & index->tableMask], 1);
+		}
+
+		if(pack_index_insert(index, hash, i, end)) {
+			continue;
 		}
 
 		// more space please!
-		if(numEntries >= allocSize) {
-			allocSize += 20;
-			entries = realloc(entries, sizeof(struct pack_index_entry *)*allocSize);
+		if(job->numDeferred[range] >= alloc) {
+			alloc = max(alloc*2, 16);
+			job->deferred[range] = realloc(job->deferred[range], alloc*sizeof(size_t));
+
+			if(!job->deferred[range]) {
+				fatal("failed to allocate the pack index");
+			}
 		}
 
-		entries[numEntries] = entry;
-		numEntries++;
+		job->deferred[range][job->numDeferred[range]++] = i;
 	}
+}
 
-	// remove excess
-	if(allocSize > numEntries) {
-		allocSize = numEntries;
-		entries = realloc(entries, sizeof(struct pack_index_entry *)*allocSize);
+// The table is split into one range per worker, so that the workers never
+// touch the same slots. Entries with the same hash share a range and are
+// inserted in index order, as are the few deferred ones left over once the
+// workers are done, so pack_index_find still finds the first entry first.
+static void pack_index_build_table(struct pack_index * index, const uint32_t * hashes, unsigned numWorkers)
+{
+	size_t tableSize = index->tableMask+1;
+	size_t numRanges = 1;
+
+	while(numRanges < numWorkers && numRanges < PACK_INDEX_MAX_RANGES && numRanges*2 <= tableSize) {
+		numRanges *= 2;
 	}
 
-	index->numEntries = numEntries;
-	index->index = entries;
+	size_t * deferred[PACK_INDEX_MAX_RANGES];
+	size_t numDeferred[PACK_INDEX_MAX_RANGES];
+
+	struct pack_index_table_job job;
+	job.index = index;
+	job.hashes = hashes;
+	job.rangeSize = tableSize/numRanges;
+	job.deferred = deferred;
+	job.numDeferred = numDeferred;
+
+	memset(index->table, 0, tableSize*sizeof(struct pack_index_slot));
+
+	pool_run(numWorkers, numRanges, pack_index_fill_table, &job);
+
+	size_t r, i;
+	for(r = 0; r < numRanges; r++) {
+		for(i = 0; i < numDeferred[r]; i++) {
+			size_t entry = deferred[r][i];
+			pack_index_insert(index, hashes[entry], entry, SIZE_MAX);
+		}
+
+		free(deferred[r]);
+	}
+}
+
+static inline bool pack_index_name_equal(const char * a, const char * b, bool ignoreCase)
+{
+	return ignoreCase ? strcasecmp(a, b) == 0 : strcmp(a, b) == 0;
+}
+
+// Returns the position of the first entry called `name`, or
+// PACK_INDEX_NOT_FOUND. The game itself doesn't care about case, so most
+// callers will want to ignore it too.
+size_t pack_index_find(const struct pack_index * index, const char * name, bool ignoreCase)
+{
+	if(!index->table) {
+		return PACK_INDEX_NOT_FOUND;
+	}
+
+	uint32_t hash = pack_index_hash(name);
+	size_t slot = hash & index->tableMask;
+
+	// entries were inserted in index order, so the first hit is the first entry
+	for(; index->table[slot].entry != 0; slot = (slot+1) & index->tableMask) {
+		if(index->table[slot].hash != hash) {
+			continue;
+		}
+
+		size_t pos = index->table[slot].entry-1;
+
+		if(pack_index_name_equal(pack_index_name(index, &index->index[pos]), name, ignoreCase)) {
+			return pos;
+		}
+	}
+
+	return PACK_INDEX_NOT_FOUND;
+}
+
+struct pack_index_entry * pack_index_lookup(const struct pack_index * index, const char * name, bool ignoreCase)
+{
+	size_t pos = pack_index_find(index, name, ignoreCase);
+
+	return pos == PACK_INDEX_NOT_FOUND ? NULL : &index->index[pos];
+}
+
+void pack_index_lazy_init(struct pack_index_lazy * lazy, const char * indexData, size_t indexSize)
+{
+	memset(lazy, 0, sizeof(*lazy));
+
+	lazy->index.names = indexData;
+	lazy->index.namesSize = indexSize;
+}
+
+// Adds the entry parsed last to the table. The table is rebuilt twice as big
+// whenever it would be more than half full, so every entry is inserted a
+// constant number of times on average.
+static bool pack_index_lazy_insert(struct pack_index_lazy * lazy)
+{
+	struct pack_index * index = &lazy->index;
+	size_t last = index->numEntries-1;
+	size_t i;
+
+	if(!index->table || index->numEntries*2 > index->tableMask+1) {
+		size_t tableSize = pack_index_table_size(index->numEntries);
+		struct pack_index_slot * table = calloc(tableSize, sizeof(struct pack_index_slot));
+
+		if(!table) {
+			return false;
+		}
+
+		free(index->table);
+		index->table = table;
+		index->tableMask = tableSize-1;
+
+		// in index order, so that the first of several entries with a name is found first
+		for(i = 0; i < last; i++) {
+			pack_index_insert(index, lazy->hashes[i], i, SIZE_MAX);
+		}
+	}
+
+	pack_index_insert(index, lazy->hashes[last], last, SIZE_MAX);
 
 	return true;
-error:
-	if(entries) {
-		free(entries);
+}
 
-		struct pack_index idx;
-		idx.numEntries = numEntries;
-		idx.index = entries;
+// Parses the entry after the last one parsed. Returns false once there are
+// no more entries, or when the next one is broken.
+static bool pack_index_lazy_next(struct pack_index_lazy * lazy)
+{
+	struct pack_index * index = &lazy->index;
 
-		pack_index_free(&idx);
+	if(lazy->scanned >= index->namesSize || lazy->broken) {
+		return false;
 	}
 
-	return false;
+	size_t end = pack_index_find_nul(index->names, lazy->scanned, index->namesSize);
+
+	// make sure the name and its fields are all there
+	if(end+1+PACK_INDEX_FIELDS_SIZE > index->namesSize) {
+		lazy->broken = true;
+		return false;
+	}
+
+	// more space please!
+	if(index->numEntries >= lazy->allocEntries) {
+		size_t alloc = max(lazy->allocEntries*2, 64);
+		struct pack_index_entry * entries = realloc(index->index, alloc*sizeof(struct pack_index_entry));
+		uint32_t * hashes = entries ? realloc(lazy->hashes, alloc*sizeof(uint32_t)) : NULL;
+
+		if(entries) {
+			index->index = entries;
+		}
+
+		if(!hashes) {
+			lazy->broken = true;
+			return false;
+		}
+
+		lazy->hashes = hashes;
+		lazy->allocEntries = alloc;
+	}
+
+	struct pack_index_entry * entry = &index->index[index->numEntries];
+	uint32_t fields[PACK_INDEX_FIELDS_SIZE/4];
+
+	memcpy(fields, index->names+end+1, PACK_INDEX_FIELDS_SIZE);
+
+	entry->nameOffset = lazy->scanned;
+	entry->unk1 = fields[0];
+	entry->offset = fields[1];
+	entry->unk3 = fields[2];
+	entry->compressedSize = fields[3];
+	entry->decompressedSize = fields[4];
+	entry->crc = fields[5];
+
+	lazy->hashes[index->numEntries++] = pack_index_hash(index->names+lazy->scanned);
+	lazy->scanned = end+1+PACK_INDEX_FIELDS_SIZE;
+
+	if(!pack_index_lazy_insert(lazy)) {
+		lazy->broken = true;
+		return false;
+	}
+
+	return true;
 }
 
-void pack_index_free(struct pack_index * index)
+// Everything is parsed, the table goes behind the entries as it does for a
+// fully parsed index
+static bool pack_index_lazy_finish(struct pack_index_lazy * lazy)
 {
-	assert(index);
+	struct pack_index * index = &lazy->index;
+	size_t tableSize = pack_index_table_size(index->numEntries);
+
+	// the table of the entries parsed so far is replaced by one behind them
+	free(index->table);
+	index->table = NULL;
+
+	struct pack_index_entry * entries = realloc(index->index, index->numEntries*sizeof(struct pack_index_entry) +
+	    tableSize*sizeof(struct pack_index_slot));
+
+	if(!entries) {
+		lazy->broken = true;
+		return false;
+	}
+
+	index->index = entries;
+	index->table = (struct pack_index_slot *)(entries+index->numEntries);
+	index->tableMask = tableSize-1;
+
+	pack_index_build_table(index, lazy->hashes, 1);
+
+	free(lazy->hashes);
+	lazy->hashes = NULL;
+	lazy->complete = true;
+
+	return true;
+}
+
+// Like pack_index_find, but parses no more of the index than it needs to.
+// Entries parsed by earlier calls are found in the table of those. A name
+// that isn't in the index at all gets the whole index parsed, after which
+// the table is that of a fully parsed index.
+size_t pack_index_lazy_find(struct pack_index_lazy * lazy, const char * name, bool ignoreCase)
+{
+	struct pack_index * index = &lazy->index;
+	size_t pos = pack_index_find(index, name, ignoreCase);
+
+	if(pos != PACK_INDEX_NOT_FOUND || lazy->complete) {
+		return pos;
+	}
 
+	uint32_t hash = pack_index_hash(name);
 	size_t i;
-	for(i = 0; i < index->numEntries; i++) {
-		struct pack_index_entry * e = index->index[i];
 
-		free(e->name);
-		free(e);
+	while(pack_index_lazy_next(lazy)) {
+		i = index->numEntries-1;
+
+		if(lazy->hashes[i] == hash && pack_index_name_equal(pack_index_name(index, &index->index[i]), name, ignoreCase)) {
+			return i;
+		}
+	}
+
+	if(!lazy->broken) {
+		pack_index_lazy_finish(lazy);
+	}
+
+	return PACK_INDEX_NOT_FOUND;
+}
+
+void pack_index_lazy_free(struct pack_index_lazy * lazy)
+{
+	// once complete the table shares the entries' allocation
+	if(!lazy->complete) {
+		free(lazy->index.table);
+		lazy->index.table = NULL;
 	}
 
-	free(index->index);
+	free(lazy->hashes);
+	pack_index_free(&lazy->index);
 }
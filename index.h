@@ -5,8 +5,14 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+// Every entry of the decompressed index is a NUL terminated name followed by
+// these six fields
+#define PACK_INDEX_FIELDS_SIZE 24
+
+// The fields are those that follow the entry's name in the index. Names are
+// not copied, they are found at nameOffset in pack_index.names.
 struct pack_index_entry {
-  char * name;
+  uint32_t nameOffset;
   uint32_t unk1; // always zero
   uint32_t offset;
   uint32_t unk3; // always zero
@@ -15,12 +21,58 @@ struct pack_index_entry {
   uint32_t crc;
 };
 
+// One slot of the name lookup table. Slots are found by the case folded hash
+// of the name and store it to avoid most string compares.
+struct pack_index_slot {
+  uint32_t hash;
+  uint32_t entry; // position in the index plus one, zero for an empty slot
+};
+
 struct pack_index {
   size_t numEntries;
-  struct pack_index_entry ** index;
+  const char * names; // the decompressed index, which has to outlive this
+  size_t namesSize;
+
+  // the entries and the lookup table share a single allocation
+  struct pack_index_entry * index;
+
+  // open addressing table with linear probing, the size is a power of two
+  struct pack_index_slot * table;
+  size_t tableMask;
+
+  // set when all of the above lives in a cache file, see index_cache.h
+  void * cache;
+  size_t cacheSize;
 };
 
-bool pack_index_parse(char * indexData, size_t indexSize, struct pack_index * index);
+// An index that is parsed only as far as lookups need it, for when just a
+// few entries are wanted. Entries are parsed in order, so their positions
+// are those they would have in a fully parsed index.
+struct pack_index_lazy {
+  // The entries parsed so far and a table of them. Until the index is
+  // complete the table is an allocation of its own that grows with it.
+  struct pack_index index;
+  uint32_t * hashes;       // of the names parsed so far, until complete
+  size_t allocEntries;
+  size_t scanned;          // bytes of the index parsed so far
+  bool complete;
+  bool broken;             // parsing ran into a malformed entry
+};
+
+#define PACK_INDEX_NOT_FOUND ((size_t)-1)
+
+bool pack_index_parse(const char * indexData, size_t indexSize, struct pack_index * index, unsigned jobs);
 void pack_index_free(struct pack_index * index);
+size_t pack_index_find(const struct pack_index * index, const char * name, bool ignoreCase);
+struct pack_index_entry * pack_index_lookup(const struct pack_index * index, const char * name, bool ignoreCase);
+
+void pack_index_lazy_init(struct pack_index_lazy * lazy, const char * indexData, size_t indexSize);
+size_t pack_index_lazy_find(struct pack_index_lazy * lazy, const char * name, bool ignoreCase);
+void pack_index_lazy_free(struct pack_index_lazy * lazy);
+
+static inline const char * pack_index_name(const struct pack_index * index, const struct pack_index_entry * e)
+{
+  return index->names+e->nameOffset;
+}
 
 #endif
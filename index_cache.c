@@ -0,0 +1,208 @@
+#include "index_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "asprintf.h"
+#include "util.h"
+#include "fs.h"
+
+#define PACK_INDEX_CACHE_MAGIC "PSPKIDX"
+#define PACK_INDEX_CACHE_VERSION 1
+
+// Caches are only read by the build that wrote them, a different layout or
+// byte order makes them stale rather than wrong
+#define PACK_INDEX_CACHE_LAYOUT (0x01020304u ^ (uint32_t)(sizeof(struct pack_index_entry) << 8 | \
+    sizeof(struct pack_index_slot)))
+
+// The file is this header, the pack's file name padded to 8 bytes, the
+// entries, the lookup table and the names, in that order
+struct pack_index_cache_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t layout;
+  struct pack_index_cache_key key;
+  uint32_t fileNameSize; // including the NUL and padding
+  uint64_t numEntries;
+  uint64_t tableSize;
+  uint64_t namesSize;
+};
+
+static char * pack_index_cache_path(const char * packPath)
+{
+  return string_cat(packPath, PACK_INDEX_CACHE_SUFFIX);
+}
+
+// The key is compared field by field, its padding is undefined
+static bool pack_index_cache_key_equal(const struct pack_index_cache_key * a, const struct pack_index_cache_key * b)
+{
+  return a->packSize == b->packSize && a->packMtime == b->packMtime &&
+    memcmp(&a->header, &b->header, sizeof(a->header)) == 0 && a->indexCrc == b->indexCrc;
+}
+
+// Fills in the key of the pack `c` reads, whose header is `header`
+bool pack_index_cache_key_read(struct pack_index_cache_key * key, struct pack_cursor * c, const struct pack_header * header)
+{
+  uint8_t head[LZO_OBJECT_HEADER_SIZE];
+  struct lzo_object obj;
+
+  if(!pack_cursor_read(c, sizeof(*header), head, sizeof(head)) ||
+      !lzo_object_parse(head, header->compressed_index_size, &obj)) {
+    return false;
+  }
+
+  memset(key, 0, sizeof(*key));
+  key->packSize = c->reader->size;
+  key->packMtime = file_mtime(c->reader->path);
+  key->header = *header;
+  key->indexCrc = obj.crc;
+
+  return true;
+}
+
+// A damaged cache of the right size could still send lookups outside the
+// mapping. Every name has to start no later than the NUL ending the last one,
+// and the table has to hold every entry once, which leaves empty slots to
+// end the probes.
+static bool pack_index_cache_valid(const struct pack_index * index)
+{
+  size_t lastName = index->namesSize-PACK_INDEX_FIELDS_SIZE-1;
+  size_t used = 0, i;
+
+  for(i = 0; i < index->numEntries; i++) {
+    if(index->index[i].nameOffset > lastName) {
+      return false;
+    }
+  }
+
+  for(i = 0; i <= index->tableMask; i++) {
+    if(index->table[i].entry > index->numEntries) {
+      return false;
+    }
+
+    if(index->table[i].entry != 0) {
+      used++;
+    }
+  }
+
+  return used == index->numEntries;
+}
+
+bool pack_index_cache_load(const char * packPath, const struct pack_index_cache_key * key, struct pack_index * index)
+{
+  char * cachePath = pack_index_cache_path(packPath);
+  char * fileName = basename(packPath, false);
+  size_t size = 0;
+  uint8_t * cache = file_map_read(cachePath, &size);
+  const struct pack_index_cache_header * h = (const struct pack_index_cache_header *)cache;
+
+  free(cachePath);
+
+  if(!cache) {
+    free(fileName);
+    return false;
+  }
+
+  uint64_t fileNameSize = (strlen(fileName)+1+7) & ~7;
+
+  // everything has to add up to the size of the file
+  bool ok = size >= sizeof(*h) &&
+    memcmp(h->magic, PACK_INDEX_CACHE_MAGIC, sizeof(h->magic)) == 0 &&
+    h->version == PACK_INDEX_CACHE_VERSION &&
+    h->layout == PACK_INDEX_CACHE_LAYOUT &&
+    pack_index_cache_key_equal(&h->key, key) &&
+    h->fileNameSize == fileNameSize &&
+    size-sizeof(*h) >= fileNameSize &&
+    strcmp((const char *)cache+sizeof(*h), fileName) == 0 &&
+    h->tableSize >= 16 && (h->tableSize & (h->tableSize-1)) == 0 &&
+    h->numEntries <= h->tableSize/2 &&
+    h->namesSize > 0 && h->namesSize <= UINT32_MAX &&
+    sizeof(*h)+fileNameSize+h->numEntries*sizeof(struct pack_index_entry)+
+      h->tableSize*sizeof(struct pack_index_slot)+h->namesSize == size;
+
+  free(fileName);
+
+  if(!ok) {
+    file_unmap_read(cache, size);
+    return false;
+  }
+
+  uint8_t * data = cache+sizeof(*h)+fileNameSize;
+
+  index->numEntries = h->numEntries;
+  index->index = (struct pack_index_entry *)data;
+  data += h->numEntries*sizeof(struct pack_index_entry);
+  index->table = (struct pack_index_slot *)data;
+  index->tableMask = h->tableSize-1;
+  data += h->tableSize*sizeof(struct pack_index_slot);
+  index->names = (const char *)data;
+  index->namesSize = h->namesSize;
+  index->cache = cache;
+  index->cacheSize = size;
+
+  // the index always ends with the last name's NUL and its fields
+  if(index->namesSize < PACK_INDEX_FIELDS_SIZE+1 ||
+      index->names[index->namesSize-PACK_INDEX_FIELDS_SIZE-1] != '\0' ||
+      !pack_index_cache_valid(index)) {
+    pack_index_free(index);
+    return false;
+  }
+
+  return true;
+}
+
+// The cache is written next to its final name and renamed over it, so that
+// other processes opening the same pack only ever see a complete one
+bool pack_index_cache_store(const char * packPath, const struct pack_index_cache_key * key, const struct pack_index * index)
+{
+  struct pack_index_cache_header h;
+  char * cachePath = pack_index_cache_path(packPath);
+  char * fileName = basename(packPath, false);
+  char * tmpPath = NULL;
+  uint64_t padding = 0;
+  bool ok = false;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, PACK_INDEX_CACHE_MAGIC, sizeof(h.magic));
+  h.version = PACK_INDEX_CACHE_VERSION;
+  h.layout = PACK_INDEX_CACHE_LAYOUT;
+  h.key = *key;
+  h.fileNameSize = (strlen(fileName)+1+7) & ~7;
+  h.numEntries = index->numEntries;
+  h.tableSize = index->tableMask+1;
+  h.namesSize = index->namesSize;
+
+  asprintf(&tmpPath, "%s.%d.tmp", cachePath, (int)getpid());
+
+  int fd = tmpPath ? file_create(tmpPath) : -1;
+
+  if(fd >= 0) {
+    ok = index->namesSize > 0 &&
+      file_write_all(fd, &h, sizeof(h)) &&
+      file_write_all(fd, fileName, strlen(fileName)+1) &&
+      file_write_all(fd, &padding, h.fileNameSize-(strlen(fileName)+1)) &&
+      file_write_all(fd, index->index, index->numEntries*sizeof(struct pack_index_entry)) &&
+      file_write_all(fd, index->table, h.tableSize*sizeof(struct pack_index_slot)) &&
+      file_write_all(fd, index->names, index->namesSize);
+
+    close(fd);
+
+#ifdef PLATFORM_WINDOWS
+    if(ok)
+      remove(cachePath);
+#endif
+
+    if(!ok || rename(tmpPath, cachePath) != 0) {
+      remove(tmpPath);
+      ok = false;
+    }
+  }
+
+  free(tmpPath);
+  free(fileName);
+  free(cachePath);
+
+  return ok;
+}
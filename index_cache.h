@@ -0,0 +1,31 @@
+#ifndef PSPACK_INDEX_CACHE_H
+#define PSPACK_INDEX_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pack.h"
+#include "index.h"
+
+// A parsed index can be kept next to its pack, in PACK.idx, and mapped
+// straight back in the next time the pack is opened. The cache holds the
+// entries, the lookup table and the names exactly as pack_index_parse left
+// them, so loading it takes neither decompression nor parsing.
+//
+// A cache belongs to the pack it was made for as long as everything here
+// still matches. It is trusted like the pack itself.
+struct pack_index_cache_key
+{
+  uint64_t packSize;
+  uint64_t packMtime;
+  struct pack_header header;
+  uint32_t indexCrc; // from the header of the index object
+};
+
+#define PACK_INDEX_CACHE_SUFFIX ".idx"
+
+bool pack_index_cache_key_read(struct pack_index_cache_key * key, struct pack_cursor * c, const struct pack_header * header);
+bool pack_index_cache_load(const char * packPath, const struct pack_index_cache_key * key, struct pack_index * index);
+bool pack_index_cache_store(const char * packPath, const struct pack_index_cache_key * key, const struct pack_index * index);
+
+#endif
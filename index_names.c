@@ -0,0 +1,268 @@
+#include "index_names.h"
+
+#include <string.h>
+#include <strings.h>
+
+#include "util.h"
+
+// Longest a varint of a size_t can get
+#define PACK_NAMES_VARINT_MAX 10
+
+struct pack_names_sort
+{
+  const char * name;
+  size_t entry;
+};
+
+static uint8_t * pack_names_put_varint(uint8_t * p, size_t value)
+{
+  while(value >= 0x80) {
+    *p++ = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+
+  *p++ = (uint8_t)value;
+  return p;
+}
+
+static const uint8_t * pack_names_get_varint(const uint8_t * p, size_t * value)
+{
+  size_t v = 0;
+  unsigned shift = 0;
+
+  for(; *p & 0x80; shift += 7) {
+    v |= (size_t)(*p++ & 0x7f) << shift;
+  }
+
+  *value = v | (size_t)*p++ << shift;
+  return p;
+}
+
+// Case folded like lookups, ties keep an order that doesn't depend on qsort
+static int pack_names_compare(const void * a, const void * b)
+{
+  const struct pack_names_sort * l = a;
+  const struct pack_names_sort * r = b;
+  int cmp = strcasecmp(l->name, r->name);
+
+  if(cmp == 0) {
+    cmp = strcmp(l->name, r->name);
+  }
+
+  if(cmp == 0) {
+    cmp = l->entry < r->entry ? -1 : l->entry > r->entry;
+  }
+
+  return cmp;
+}
+
+// Builds the table from a parsed index, which only has to outlive the call
+bool pack_names_build(struct pack_names * names, const struct pack_index * index)
+{
+  size_t n = index->numEntries;
+  size_t i, bound = 0;
+
+  memset(names, 0, sizeof(*names));
+
+  if(n == 0) {
+    return true;
+  }
+
+  struct pack_names_sort * sorted = malloc(n*sizeof(*sorted));
+
+  if(!sorted) {
+    return false;
+  }
+
+  for(i = 0; i < n; i++) {
+    sorted[i].name = pack_index_name(index, &index->index[i]);
+    sorted[i].entry = i;
+    bound += strlen(sorted[i].name)+1+2*PACK_NAMES_VARINT_MAX;
+  }
+
+  qsort(sorted, n, sizeof(*sorted), pack_names_compare);
+
+  names->numNames = n;
+  names->numRestarts = (n+PACK_NAMES_RESTART-1)/PACK_NAMES_RESTART;
+  names->data = malloc(bound);
+  names->restarts = malloc(names->numRestarts*sizeof(uint32_t));
+
+  if(!names->data || !names->restarts) {
+    free(sorted);
+    pack_names_free(names);
+    return false;
+  }
+
+  uint8_t * p = names->data;
+  const char * prev = "";
+
+  for(i = 0; i < n; i++) {
+    const char * name = sorted[i].name;
+    size_t shared = 0;
+
+    if(i % PACK_NAMES_RESTART == 0) {
+      size_t offset = p-names->data;
+
+      // restart points are kept small, a table this big isn't worth having
+      if(offset > UINT32_MAX) {
+        free(sorted);
+        pack_names_free(names);
+        return false;
+      }
+
+      names->restarts[i/PACK_NAMES_RESTART] = (uint32_t)offset;
+    } else {
+      while(name[shared] && name[shared] == prev[shared])
+        shared++;
+    }
+
+    size_t suffix = strlen(name+shared)+1;
+
+    p = pack_names_put_varint(p, shared);
+    p = pack_names_put_varint(p, sorted[i].entry);
+    memcpy(p, name+shared, suffix);
+    p += suffix;
+    prev = name;
+  }
+
+  free(sorted);
+
+  names->dataSize = p-names->data;
+
+  // the bound assumed nothing was shared, give back what was
+  uint8_t * shrunk = realloc(names->data, names->dataSize);
+
+  if(shrunk) {
+    names->data = shrunk;
+  }
+
+  return true;
+}
+
+void pack_names_free(struct pack_names * names)
+{
+  free(names->data);
+  free(names->restarts);
+  memset(names, 0, sizeof(*names));
+}
+
+void pack_names_iter_init(struct pack_names_iter * it, const struct pack_names * names, size_t rank)
+{
+  memset(it, 0, sizeof(*it));
+  it->names = names;
+
+  if(rank >= names->numNames) {
+    it->rank = names->numNames;
+    it->offset = names->dataSize;
+    return;
+  }
+
+  // decode from the restart point before the rank, names depend on the one before them
+  it->rank = rank/PACK_NAMES_RESTART*PACK_NAMES_RESTART;
+  it->offset = names->restarts[rank/PACK_NAMES_RESTART];
+
+  while(it->rank < rank)
+    pack_names_next(it);
+}
+
+// Decodes the name of rank it->rank into it->name, false past the last name
+bool pack_names_next(struct pack_names_iter * it)
+{
+  const struct pack_names * names = it->names;
+
+  if(it->rank >= names->numNames) {
+    return false;
+  }
+
+  const uint8_t * p = names->data+it->offset;
+  size_t shared;
+
+  p = pack_names_get_varint(p, &shared);
+  p = pack_names_get_varint(p, &it->entry);
+
+  size_t suffix = strlen((const char *)p)+1;
+
+  if(shared+suffix > it->nameAlloc) {
+    it->nameAlloc = max(shared+suffix, it->nameAlloc*2);
+    it->name = realloc(it->name, it->nameAlloc);
+
+    if(!it->name) {
+      fatal("failed to allocate %"PRIuSZT" bytes for a name", it->nameAlloc);
+    }
+  }
+
+  memcpy(it->name+shared, p, suffix);
+  it->nameSize = shared+suffix-1;
+  it->offset = p+suffix-names->data;
+  it->rank++;
+
+  return true;
+}
+
+void pack_names_iter_free(struct pack_names_iter * it)
+{
+  free(it->name);
+  it->name = NULL;
+  it->nameAlloc = 0;
+}
+
+// Restart names share nothing, so they can be compared where they are
+static const char * pack_names_restart_name(const struct pack_names * names, size_t restart)
+{
+  const uint8_t * p = names->data+names->restarts[restart];
+  size_t ignored;
+
+  p = pack_names_get_varint(p, &ignored);
+  p = pack_names_get_varint(p, &ignored);
+
+  return (const char *)p;
+}
+
+// Whether `name` sorts before the first name starting with `prefix` or, for
+// the upper bound, before the first name after those
+static inline bool pack_names_before(const char * name, const char * prefix, size_t prefixLen, bool upper)
+{
+  return upper ? strncasecmp(name, prefix, prefixLen) <= 0 : strcasecmp(name, prefix) < 0;
+}
+
+// Returns the number of names that sort before the bound
+static size_t pack_names_bound(const struct pack_names * names, const char * prefix, bool upper)
+{
+  size_t prefixLen = strlen(prefix);
+  size_t lo = 0, hi = names->numRestarts;
+
+  while(lo < hi) {
+    size_t mid = lo+(hi-lo)/2;
+
+    if(pack_names_before(pack_names_restart_name(names, mid), prefix, prefixLen, upper)) {
+      lo = mid+1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if(lo == 0) {
+    return 0;
+  }
+
+  // the bound is in the block of the last restart name before it
+  struct pack_names_iter it;
+  size_t rank = (lo-1)*PACK_NAMES_RESTART;
+
+  pack_names_iter_init(&it, names, rank);
+
+  while(pack_names_next(&it) && pack_names_before(it.name, prefix, prefixLen, upper))
+    rank++;
+
+  pack_names_iter_free(&it);
+
+  return rank;
+}
+
+// Finds the ranks [first, last) of the names starting with `prefix`,
+// ignoring case. An empty prefix gives every name.
+void pack_names_range(const struct pack_names * names, const char * prefix, size_t * first, size_t * last)
+{
+  *first = pack_names_bound(names, prefix, false);
+  *last = pack_names_bound(names, prefix, true);
+}
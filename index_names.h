@@ -0,0 +1,52 @@
+#ifndef PSPACK_INDEX_NAMES_H
+#define PSPACK_INDEX_NAMES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "index.h"
+
+// Every this many names the table stores a name in full
+#define PACK_NAMES_RESTART 16
+
+// The names of an index in case folded order, front coded: every name is
+// stored as the number of bytes it shares with the name before it, the
+// position of its entry and the rest of the name, NUL terminated. Asset
+// paths repeat long directory prefixes, so this is much smaller than the
+// names themselves.
+//
+// Every PACK_NAMES_RESTART-th name shares nothing and so is stored whole.
+// These restart points are binary searched, after which at most one block
+// of names is decoded, so the names starting with a prefix are found in
+// O(log n) and listed in O(k).
+struct pack_names
+{
+  size_t numNames;
+  uint8_t * data;
+  size_t dataSize;
+  uint32_t * restarts; // offset in data of every restart name
+  size_t numRestarts;
+};
+
+// Walks the names in order from some rank, decoding them one at a time
+struct pack_names_iter
+{
+  const struct pack_names * names;
+  size_t rank;   // of the name next() decodes
+  size_t offset; // in data of that name
+  char * name;   // the name decoded last
+  size_t nameSize;
+  size_t nameAlloc;
+  size_t entry;  // its position in the index
+};
+
+bool pack_names_build(struct pack_names * names, const struct pack_index * index);
+void pack_names_free(struct pack_names * names);
+void pack_names_range(const struct pack_names * names, const char * prefix, size_t * first, size_t * last);
+
+void pack_names_iter_init(struct pack_names_iter * it, const struct pack_names * names, size_t rank);
+bool pack_names_next(struct pack_names_iter * it);
+void pack_names_iter_free(struct pack_names_iter * it);
+
+#endif
@@ -0,0 +1,125 @@
+#include "lzo1x_batch.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "minilzo.h"
+#include "lzo1x_enc.h"
+#include "lzo1x_dec.h"
+#include "crc32.h"
+
+// What the next instruction of a stream means depends on what came before
+// it: tokens below 16 are a literal run after a match, but a match right
+// after literals.
+enum lzo1x_lane_state
+{
+  LZO_LANE_FIRST,       // the start of the stream, which can begin with literals
+  LZO_LANE_AFTER_MATCH, // a match without trailing literals
+  LZO_LANE_AFTER_SHORT, // 1 to 3 literals, short tokens are 2 byte M1 matches
+  LZO_LANE_AFTER_LONG   // 4 or more literals, short tokens are 3 byte M1 matches
+};
+
+// The local variables of the decoder between two turns
+struct lzo1x_lane
+{
+  const uint8_t * ip;
+  const uint8_t * ipEnd;
+  uint8_t * op;
+  uint8_t * opEnd;
+  uint8_t * out;
+  uint32_t * crc;
+  size_t crcNext;
+  enum lzo1x_lane_state state;
+  struct lzo1x_stream * stream;
+};
+
+typedef bool (*lzo1x_lane_fn)(struct lzo1x_lane * l, unsigned budget);
+
+// Instructions a lane decodes per turn. Switching lanes after every one
+// costs more than it hides, after a few dozen the switch is lost in the noise.
+#define LZO_LANE_QUANTUM 128
+
+static void lzo1x_lane_start(struct lzo1x_lane * l, struct lzo1x_stream * s)
+{
+  l->ip = s->in;
+  l->ipEnd = s->in+s->inLen;
+  l->op = s->out;
+  l->opEnd = s->out+s->outLen;
+  l->out = s->out;
+  l->crc = s->crc;
+  l->crcNext = s->crc ? LZO1X_CRC_BLOCK : SIZE_MAX;
+  l->state = LZO_LANE_FIRST;
+  l->stream = s;
+
+  __builtin_prefetch(s->in);
+  __builtin_prefetch(s->in+64);
+}
+
+// Ends the stream of a lane, which is then free for the next one
+static inline bool lzo1x_lane_finish(struct lzo1x_lane * l, uint8_t * op, size_t crcNext, int result)
+{
+  struct lzo1x_stream * s = l->stream;
+
+  s->outLen = op-l->out;
+  s->result = result;
+
+  if(s->crc && result == LZO_E_OK)
+    *s->crc = crc32_update(*s->crc, l->out+crcNext-LZO1X_CRC_BLOCK, s->outLen-(crcNext-LZO1X_CRC_BLOCK));
+
+  return false;
+}
+
+// One turn of a lane, returning false once its stream is done
+#define LZO_DEC_LANE
+#define LZO_DEC_ATTR static inline
+#define LZO_DEC_WIDE 16
+#define LZO_DEC_COPY_WIDE(d, s) memcpy(d, s, 16)
+#define LZO_DEC_NAME lzo1x_lane_run
+#include "lzo1x_dec.ch"
+#undef LZO_DEC_NAME
+#define LZO_DEC_SAFE
+#define LZO_DEC_NAME lzo1x_lane_run_safe
+#include "lzo1x_dec.ch"
+#undef LZO_DEC_NAME
+#undef LZO_DEC_SAFE
+#undef LZO_DEC_ATTR
+#undef LZO_DEC_WIDE
+#undef LZO_DEC_COPY_WIDE
+#undef LZO_DEC_LANE
+
+// Inlined into both entry points, so the lanes' turns are direct calls
+static inline __attribute__((always_inline))
+void lzo1x_batch_run(struct lzo1x_stream * streams, size_t numStreams, lzo1x_lane_fn run)
+{
+  struct lzo1x_lane lanes[LZO1X_BATCH_LANES];
+  unsigned active = 0;
+  size_t next = 0;
+
+  for(;;) {
+    // a finished stream's lane goes to the next one waiting
+    while(active < LZO1X_BATCH_LANES && next < numStreams)
+      lzo1x_lane_start(&lanes[active++], &streams[next++]);
+
+    if(active == 0)
+      break;
+
+    unsigned i = 0;
+
+    while(i < active) {
+      if(run(&lanes[i], LZO_LANE_QUANTUM))
+        i++;
+      else
+        lanes[i] = lanes[--active];
+    }
+  }
+}
+
+void lzo1x_decompress_batch(struct lzo1x_stream * streams, size_t numStreams)
+{
+  lzo1x_batch_run(streams, numStreams, lzo1x_lane_run);
+}
+
+void lzo1x_decompress_batch_safe(struct lzo1x_stream * streams, size_t numStreams)
+{
+  lzo1x_batch_run(streams, numStreams, lzo1x_lane_run_safe);
+}
@@ -0,0 +1,37 @@
+#ifndef LZO1X_BATCH_H
+#define LZO1X_BATCH_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// Decodes many independent LZO1X streams on one thread by taking turns: each
+// stream in flight decodes a few dozen instructions, then the next stream
+// gets its turn. A short stream spends much of its time waiting on its own
+// loads and mispredicted branches, interleaving several of them lets the CPU
+// overlap that work instead of stalling on it.
+//
+// The lanes run the decoder of lzo1x_dec.ch, so the results are those of
+// lzo1x_decompress_fast and lzo1x_decompress_fast_safe.
+
+// Streams in flight at once
+#ifndef LZO1X_BATCH_LANES
+#define LZO1X_BATCH_LANES 2
+#endif
+
+struct lzo1x_stream
+{
+  const uint8_t * in;
+  size_t inLen;
+  uint8_t * out;
+  size_t outLen; // room at `out` on the way in, the decoded size on the way out
+  int result;    // an LZO_E_* code
+  uint32_t * crc; // when not NULL, updated like lzo1x_decompress_fast_crc does
+};
+
+// Trusts the input, like lzo1x_decompress_fast
+void lzo1x_decompress_batch(struct lzo1x_stream * streams, size_t numStreams);
+
+// Checks every instruction, like lzo1x_decompress_fast_safe
+void lzo1x_decompress_batch_safe(struct lzo1x_stream * streams, size_t numStreams);
+
+#endif
@@ -0,0 +1,134 @@
+#include "lzo1x_dec.h"
+
+#include <string.h>
+
+#include "minilzo.h"
+#include "lzo1x_enc.h"
+#include "crc32.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LZO_DEC_X86
+#include <immintrin.h>
+#endif
+
+typedef int (*lzo1x_dec_fn)(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen, uint32_t * crc);
+
+// Portable version, memcpy of a constant 16 bytes compiles to whatever the
+// target does best
+#define LZO_DEC_ATTR static
+#define LZO_DEC_WIDE 16
+#define LZO_DEC_COPY_WIDE(d, s) memcpy(d, s, 16)
+#define LZO_DEC_NAME lzo1x_decompress_generic
+#include "lzo1x_dec.ch"
+#undef LZO_DEC_NAME
+#define LZO_DEC_SAFE
+#define LZO_DEC_NAME lzo1x_decompress_generic_safe
+#include "lzo1x_dec.ch"
+#undef LZO_DEC_NAME
+#undef LZO_DEC_SAFE
+#undef LZO_DEC_ATTR
+#undef LZO_DEC_WIDE
+#undef LZO_DEC_COPY_WIDE
+
+#ifdef LZO_DEC_X86
+// 32 bit builds can't assume SSE2
+#define LZO_DEC_ATTR static __attribute__((target("sse2")))
+#define LZO_DEC_WIDE 16
+#define LZO_DEC_COPY_WIDE(d, s) \
+  _mm_storeu_si128((__m128i *)(d), _mm_loadu_si128((const __m128i *)(s)))
+#define LZO_DEC_NAME lzo1x_decompress_sse2
+#include "lzo1x_dec.ch"
+#undef LZO_DEC_NAME
+#define LZO_DEC_SAFE
+#define LZO_DEC_NAME lzo1x_decompress_sse2_safe
+#include "lzo1x_dec.ch"
+#undef LZO_DEC_NAME
+#undef LZO_DEC_SAFE
+#undef LZO_DEC_ATTR
+#undef LZO_DEC_WIDE
+#undef LZO_DEC_COPY_WIDE
+
+#define LZO_DEC_ATTR static __attribute__((target("avx2")))
+#define LZO_DEC_WIDE 32
+#define LZO_DEC_COPY_WIDE(d, s) \
+  _mm256_storeu_si256((__m256i *)(d), _mm256_loadu_si256((const __m256i *)(s)))
+#define LZO_DEC_NAME lzo1x_decompress_avx2
+#include "lzo1x_dec.ch"
+#undef LZO_DEC_NAME
+#define LZO_DEC_SAFE
+#define LZO_DEC_NAME lzo1x_decompress_avx2_safe
+#include "lzo1x_dec.ch"
+#undef LZO_DEC_NAME
+#undef LZO_DEC_SAFE
+#undef LZO_DEC_ATTR
+#undef LZO_DEC_WIDE
+#undef LZO_DEC_COPY_WIDE
+#endif
+
+struct lzo1x_dec_variant
+{
+  const char * name;
+  lzo1x_dec_fn fast;
+  lzo1x_dec_fn safe;
+};
+
+static const struct lzo1x_dec_variant variants[] = {
+  {"generic", lzo1x_decompress_generic, lzo1x_decompress_generic_safe},
+#ifdef LZO_DEC_X86
+  {"sse2", lzo1x_decompress_sse2, lzo1x_decompress_sse2_safe},
+  {"avx2", lzo1x_decompress_avx2, lzo1x_decompress_avx2_safe},
+#endif
+};
+
+static const struct lzo1x_dec_variant * volatile variant = NULL;
+
+static const struct lzo1x_dec_variant * lzo1x_dec_pick()
+{
+#ifdef LZO_DEC_X86
+  __builtin_cpu_init();
+
+  if(__builtin_cpu_supports("avx2"))
+    return &variants[2];
+
+  if(__builtin_cpu_supports("sse2"))
+    return &variants[1];
+#endif
+
+  return &variants[0];
+}
+
+// racing threads all pick the same one
+static inline const struct lzo1x_dec_variant * lzo1x_dec_variant()
+{
+  const struct lzo1x_dec_variant * v = variant;
+
+  if(!v)
+    variant = v = lzo1x_dec_pick();
+
+  return v;
+}
+
+int lzo1x_decompress_fast(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen)
+{
+  return lzo1x_dec_variant()->fast(in, inLen, out, outLen, NULL);
+}
+
+int lzo1x_decompress_fast_safe(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen)
+{
+  return lzo1x_dec_variant()->safe(in, inLen, out, outLen, NULL);
+}
+
+int lzo1x_decompress_fast_crc(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen, uint32_t * crc)
+{
+  return lzo1x_dec_variant()->fast(in, inLen, out, outLen, crc);
+}
+
+int lzo1x_decompress_fast_safe_crc(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen, uint32_t * crc)
+{
+  return lzo1x_dec_variant()->safe(in, inLen, out, outLen, crc);
+}
+
+const char * lzo1x_decompress_fast_variant()
+{
+  return lzo1x_dec_variant()->name;
+}
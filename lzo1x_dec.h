@@ -0,0 +1,33 @@
+#ifndef LZO1X_DEC_H
+#define LZO1X_DEC_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// A faster LZO1X decoder with the same results as lzo1x_decompress. Literals
+// and matches are copied a vector at a time and short offset matches are
+// expanded in blocks. The widest copies the CPU supports are picked on the
+// first call.
+//
+// `*outLen` is the room at `out` on the way in and the decoded size on the
+// way out. Like lzo1x_decompress, the input is trusted.
+int lzo1x_decompress_fast(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen);
+
+// The same, but every token is checked against the ends of the input and
+// output and the start of the output first, like lzo1x_decompress_safe.
+// Malformed input gives an error instead of touching memory it shouldn't.
+int lzo1x_decompress_fast_safe(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen);
+
+// Both of the above, also updating `*crc` with the CRC-32 (see crc32.h) of
+// the output. The checksum is taken a block at a time right behind the
+// decoder, while the output is still in the cache, instead of in a second
+// pass over all of it. `*crc` is only meaningful when LZO_E_OK comes back.
+#define LZO1X_CRC_BLOCK (16*1024)
+
+int lzo1x_decompress_fast_crc(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen, uint32_t * crc);
+int lzo1x_decompress_fast_safe_crc(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen, uint32_t * crc);
+
+// Name of the variant lzo1x_decompress_fast uses on this CPU
+const char * lzo1x_decompress_fast_variant();
+
+#endif
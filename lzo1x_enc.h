@@ -0,0 +1,173 @@
+#ifndef LZO1X_ENC_H
+#define LZO1X_ENC_H
+
+// Pieces of the LZO1X bitstream shared by our compressors. Only included by
+// the compressor sources, everything here is inlined into them.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Limits of the LZO1X match encodings. M1 matches are only possible right
+// after a literal run, M2 to M4 have increasingly long offsets.
+#define M1_MAX_OFFSET 0x0400
+#define M2_MAX_LEN 8
+#define M2_MAX_OFFSET 0x0800
+#define M3_MAX_OFFSET 0x4000
+#define M4_MAX_OFFSET 0xbfff
+
+static inline uint32_t lzo1x_read32(const uint8_t * p)
+{
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint64_t lzo1x_read64(const uint8_t * p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Number of equal bytes at `a` and the earlier `b`, not reading past `end`
+static inline uint32_t lzo1x_count_match(const uint8_t * a, const uint8_t * b, const uint8_t * end)
+{
+  const uint8_t * start = a;
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while(a+8 <= end) {
+    uint64_t diff = lzo1x_read64(a) ^ lzo1x_read64(b);
+
+    if(diff)
+      return a-start + (__builtin_ctzll(diff) >> 3);
+
+    a += 8;
+    b += 8;
+  }
+#endif
+
+  while(a < end && *a == *b) {
+    a++;
+    b++;
+  }
+
+  return a-start;
+}
+
+static inline bool lzo1x_is_m1_long(uint32_t len, uint32_t off, uint32_t litRun)
+{
+  return len == 3 && litRun >= 4 && off > M2_MAX_OFFSET && off <= M2_MAX_OFFSET+M1_MAX_OFFSET;
+}
+
+// Copies literals 16 bytes at a time while the source allows it. This may
+// write up to 15 bytes past the literals, which the compressors' output bound
+// covers.
+static inline uint8_t * lzo1x_copy_literals(uint8_t * op, const uint8_t * lit, uint32_t count,
+    const uint8_t * inEnd)
+{
+  uint8_t * end = op+count;
+
+  if(lit+count+16 <= inEnd) {
+    do {
+      memcpy(op, lit, 16);
+      op += 16;
+      lit += 16;
+    } while(op < end);
+  } else {
+    memcpy(op, lit, count);
+  }
+
+  return end;
+}
+
+// `out` is the start of the output, the first literal run is coded differently
+static inline uint8_t * lzo1x_emit_literals(uint8_t * out, uint8_t * op, const uint8_t * lit,
+    uint32_t count, const uint8_t * inEnd)
+{
+  if(count == 0)
+    return op;
+
+  if(op == out && count <= 238) {
+    *op++ = 17+count;
+  } else if(count <= 3) {
+    op[-2] |= count; // the low bits of the previous match
+  } else if(count <= 18) {
+    *op++ = count-3;
+  } else {
+    uint32_t tt = count-18;
+
+    *op++ = 0;
+    while(tt > 255) {
+      tt -= 255;
+      *op++ = 0;
+    }
+    *op++ = tt;
+  }
+
+  return lzo1x_copy_literals(op, lit, count, inEnd);
+}
+
+static inline uint8_t * lzo1x_emit_length(uint8_t * op, uint32_t len)
+{
+  while(len > 255) {
+    len -= 255;
+    *op++ = 0;
+  }
+  *op++ = len;
+
+  return op;
+}
+
+// `litRun` is the number of literals directly before the match
+static inline uint8_t * lzo1x_emit_match(uint8_t * op, uint32_t len, uint32_t off, uint32_t litRun)
+{
+  if(len == 2) {
+    off -= 1;
+    *op++ = (off & 3) << 2;
+    *op++ = off >> 2;
+  } else if(lzo1x_is_m1_long(len, off, litRun)) {
+    off -= 1 + M2_MAX_OFFSET;
+    *op++ = (off & 3) << 2;
+    *op++ = off >> 2;
+  } else if(len <= M2_MAX_LEN && off <= M2_MAX_OFFSET) {
+    off -= 1;
+    *op++ = ((len-1) << 5) | ((off & 7) << 2);
+    *op++ = off >> 3;
+  } else if(off <= M3_MAX_OFFSET) {
+    off -= 1;
+    if(len <= 33) {
+      *op++ = 32 | (len-2);
+    } else {
+      *op++ = 32;
+      op = lzo1x_emit_length(op, len-33);
+    }
+    *op++ = (off & 63) << 2;
+    *op++ = off >> 6;
+  } else {
+    off -= 0x4000;
+    uint8_t k = (off & 0x4000) >> 11;
+    if(len <= 9) {
+      *op++ = 16 | k | (len-2);
+    } else {
+      *op++ = 16 | k;
+      op = lzo1x_emit_length(op, len-9);
+    }
+    *op++ = (off & 63) << 2;
+    *op++ = (uint8_t)(off >> 6);
+  }
+
+  return op;
+}
+
+// An M4 match with a zero offset ends the stream
+static inline uint8_t * lzo1x_emit_end(uint8_t * op)
+{
+  *op++ = 16 | 1;
+  *op++ = 0;
+  *op++ = 0;
+
+  return op;
+}
+
+#endif
@@ -0,0 +1,82 @@
+#include "lzo1x_fast.h"
+
+#include "minilzo.h"
+#include "lzo1x_enc.h"
+
+// Matches are found four bytes at a time and extended eight at a time, so
+// stop looking this close to the end of the input
+#define FAST_TAIL 12
+
+// Step further ahead the longer we go without finding a match, so
+// incompressible data passes quickly
+#define FAST_SKIP_SHIFT 5
+
+static inline uint32_t hash4(uint32_t v, unsigned bits)
+{
+  return (v * 2654435761u) >> (32 - bits);
+}
+
+int lzo1x_fast_compress(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen,
+    unsigned hashBits, void * wrkmem)
+{
+  uint32_t * table = wrkmem;
+  const uint8_t * inEnd = in+inLen;
+  const uint8_t * ip = in;
+  const uint8_t * ii = in; // start of the pending literals
+  uint8_t * op = out;
+
+  if(hashBits < LZO1X_FAST_MIN_HASH_BITS || hashBits > LZO1X_FAST_MAX_HASH_BITS)
+    return LZO_E_ERROR;
+
+  if(inLen > FAST_TAIL && inLen < 0xffffffff) {
+    const uint8_t * limit = inEnd-FAST_TAIL;
+
+    // small inputs don't need the whole table, which then is cheaper to clear
+    while(hashBits > LZO1X_FAST_MIN_HASH_BITS && ((size_t)1 << (hashBits-1)) >= inLen)
+      hashBits--;
+
+    memset(table, 0, LZO1X_FAST_MEM_COMPRESS(hashBits));
+
+    // nothing to match against yet
+    ip++;
+
+    while(ip < limit) {
+      uint32_t seq = lzo1x_read32(ip);
+      uint32_t h = hash4(seq, hashBits);
+      const uint8_t * m = in+table[h];
+      uint32_t off = ip-m;
+
+      table[h] = ip-in;
+
+      if(off == 0 || off > M4_MAX_OFFSET || lzo1x_read32(m) != seq) {
+        ip += 1 + ((ip-ii) >> FAST_SKIP_SHIFT);
+        continue;
+      }
+
+      // the match may start a little earlier
+      while(ip > ii && m > in && ip[-1] == m[-1]) {
+        ip--;
+        m--;
+      }
+
+      uint32_t len = 4 + lzo1x_count_match(ip+4, m+4, inEnd);
+      uint32_t litRun = ip-ii;
+
+      op = lzo1x_emit_literals(out, op, ii, litRun, inEnd);
+      op = lzo1x_emit_match(op, len, off, litRun);
+
+      ip += len;
+      ii = ip;
+
+      // give the next search something close by to find
+      if(ip < limit)
+        table[hash4(lzo1x_read32(ip-2), hashBits)] = ip-2-in;
+    }
+  }
+
+  op = lzo1x_emit_literals(out, op, ii, inEnd-ii, inEnd);
+  op = lzo1x_emit_end(op);
+
+  *outLen = op-out;
+  return LZO_E_OK;
+}
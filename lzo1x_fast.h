@@ -0,0 +1,27 @@
+#ifndef LZO1X_FAST_H
+#define LZO1X_FAST_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// A greedy LZO1X-1 style compressor. It finds matches with a single probe of
+// a hash table, so it is fast but leaves more on the table than lzo1x_opt.
+// The output is plain LZO1X and decodes with lzo1x_decompress.
+
+// log2 of the hash table entries, larger tables find more matches in big
+// inputs but take longer to clear for small ones
+#ifndef LZO1X_FAST_HASH_BITS
+#define LZO1X_FAST_HASH_BITS 15
+#endif
+
+#define LZO1X_FAST_MIN_HASH_BITS 10
+#define LZO1X_FAST_MAX_HASH_BITS 20
+
+// Bytes of work memory for a table of 2^bits entries
+#define LZO1X_FAST_MEM_COMPRESS(bits) (sizeof(uint32_t) << (bits))
+
+// `out` needs room for inLen + inLen/16 + 64 + 3 bytes
+int lzo1x_fast_compress(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen,
+    unsigned hashBits, void * wrkmem);
+
+#endif
@@ -0,0 +1,335 @@
+#include "lzo1x_opt.h"
+
+#include <string.h>
+
+#include "minilzo.h"
+#include "util.h"
+#include "lzo1x_enc.h"
+
+#define OPT_HASH_BITS 16
+
+// the chain only has to reach back as far as the largest offset
+#define OPT_CHAIN_SIZE 0x10000
+#define OPT_CHAIN_MASK (OPT_CHAIN_SIZE-1)
+
+// The parse is done in blocks of this many input bytes. Matches do not cross
+// a block boundary, which costs a few bytes at most.
+#define OPT_BLOCK (128*1024)
+#define OPT_MAX_LEN 0xffff
+
+#define OPT_INFINITY 0xffffffff
+
+// How to arrive at a position with the fewest output bytes
+struct lzo1x_opt_node
+{
+  uint32_t cost;
+  uint32_t litRun; // literals since the last match
+  uint16_t len;    // length of the match arriving here, 0 for a literal
+  uint16_t off;
+  bool first;      // nothing has been written yet
+};
+
+struct lzo1x_opt_step
+{
+  uint32_t start;
+  uint16_t len;
+  uint16_t off;
+};
+
+struct lzo1x_opt_match
+{
+  uint32_t len;
+  uint32_t off;
+};
+
+// Positions are stored plus `base`, which moves past the input after every
+// call. Anything below it belongs to an earlier input, so the tables never
+// have to be cleared between the many small entries of a pack.
+struct lzo1x_opt
+{
+  uint32_t base;
+  uint32_t head[1 << OPT_HASH_BITS];
+  uint32_t prev[OPT_CHAIN_SIZE];
+  uint32_t head2[0x10000]; // last position of every two byte sequence
+  struct lzo1x_opt_node nodes[OPT_BLOCK+1];
+  struct lzo1x_opt_step steps[OPT_BLOCK];
+  struct lzo1x_opt_match matches[OPT_CHAIN_SIZE];
+};
+
+struct lzo1x_opt_level
+{
+  unsigned maxChain; // candidates visited per position
+  uint32_t niceLen;  // matches this long are taken without a parse
+};
+
+static const struct lzo1x_opt_level levels[] = {
+  {8, 32},    // 2
+  {16, 48},   // 3
+  {32, 64},   // 4
+  {64, 96},   // 5
+  {128, 128}, // 6
+  {256, 160}, // 7
+  {1024, 224},// 8
+  {4096, 273} // 9
+};
+
+static void reset(struct lzo1x_opt * w)
+{
+  memset(w->head, 0, sizeof(w->head));
+  memset(w->prev, 0, sizeof(w->prev));
+  memset(w->head2, 0, sizeof(w->head2));
+  w->base = 1;
+}
+
+struct lzo1x_opt * lzo1x_opt_alloc()
+{
+  struct lzo1x_opt * w = malloc(sizeof(struct lzo1x_opt));
+
+  if(w)
+    reset(w);
+
+  return w;
+}
+
+void lzo1x_opt_free(struct lzo1x_opt * w)
+{
+  free(w);
+}
+
+static inline uint32_t hash3(const uint8_t * p)
+{
+  uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+
+  return (v * 2654435761u) >> (32 - OPT_HASH_BITS);
+}
+
+static inline uint32_t read16(const uint8_t * p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+// Extra bytes a literal run of `r` costs on top of the literals themselves
+static inline uint32_t lit_overhead(uint32_t r, bool first)
+{
+  if(r == 0)
+    return 0;
+  if(first && r <= 238)
+    return 1;
+  if(!first && r <= 3)
+    return 0; // kept in the low bits of the previous match
+  if(r <= 18)
+    return 1;
+
+  return 2 + (r-19)/255;
+}
+
+static inline uint32_t match_cost(uint32_t len, uint32_t off, uint32_t litRun)
+{
+  if(len == 2 || lzo1x_is_m1_long(len, off, litRun))
+    return 2;
+  if(len <= M2_MAX_LEN && off <= M2_MAX_OFFSET)
+    return 2;
+  if(off <= M3_MAX_OFFSET)
+    return len <= 33 ? 3 : 4 + (len-34)/255;
+
+  return len <= 9 ? 3 : 4 + (len-10)/255;
+}
+
+static inline void insert(struct lzo1x_opt * w, const uint8_t * in, uint32_t pos)
+{
+  uint32_t h = hash3(in+pos);
+
+  w->prev[pos & OPT_CHAIN_MASK] = w->head[h];
+  w->head[h] = w->base+pos;
+  w->head2[read16(in+pos)] = w->base+pos;
+}
+
+// Collects matches at `pos` of strictly increasing length, each with the
+// nearest offset that reaches it
+static size_t find_matches(struct lzo1x_opt * w, const uint8_t * in, uint32_t pos,
+    uint32_t limit, const struct lzo1x_opt_level * level)
+{
+  const uint8_t * cur = in+pos;
+  uint32_t stored = w->head[hash3(cur)];
+  uint32_t best = 2;
+  unsigned chain = level->maxChain;
+  size_t num = 0;
+
+  while(stored >= w->base && chain-- > 0) {
+    uint32_t cand = stored-w->base;
+    uint32_t off = pos-cand;
+
+    if(off > M4_MAX_OFFSET)
+      break;
+
+    const uint8_t * m = in+cand;
+
+    if(m[best] == cur[best] && m[0] == cur[0]) {
+      uint32_t len = lzo1x_count_match(cur, m, cur+limit);
+
+      if(len > best) {
+        best = len;
+        w->matches[num].len = len;
+        w->matches[num].off = off;
+        num++;
+
+        if(len >= level->niceLen || len == limit)
+          break;
+      }
+    }
+
+    uint32_t next = w->prev[cand & OPT_CHAIN_MASK];
+
+    if(next >= stored)
+      break;
+
+    stored = next;
+  }
+
+  return num;
+}
+
+static inline void relax(struct lzo1x_opt_node * node, uint32_t cost, uint32_t len, uint32_t off)
+{
+  if(cost < node->cost) {
+    node->cost = cost;
+    node->litRun = 0;
+    node->len = len;
+    node->off = off;
+    node->first = false;
+  }
+}
+
+// Finds the cheapest encoding of [start, end) given the literals pending
+// before it. Returns the matches to use in order.
+static size_t parse_block(struct lzo1x_opt * w, const uint8_t * in, size_t inLen,
+    uint32_t start, uint32_t end, uint32_t litRun, bool first,
+    const struct lzo1x_opt_level * level)
+{
+  struct lzo1x_opt_node * nodes = w->nodes;
+  uint32_t blockLen = end-start;
+  uint32_t skipUntil = start;
+  uint32_t i;
+
+  nodes[0].cost = 0;
+  nodes[0].litRun = litRun;
+  nodes[0].len = 0;
+  nodes[0].first = first;
+
+  for(i = 1; i <= blockLen; i++)
+    nodes[i].cost = OPT_INFINITY;
+
+  for(i = 0; i < blockLen; i++) {
+    struct lzo1x_opt_node * node = &nodes[i];
+    uint32_t pos = start+i;
+    uint32_t r = node->litRun;
+
+    // the next byte as a literal
+    uint32_t cost = node->cost + 1 + lit_overhead(r+1, node->first) - lit_overhead(r, node->first);
+    struct lzo1x_opt_node * next = &nodes[i+1];
+
+    if(cost < next->cost) {
+      next->cost = cost;
+      next->litRun = r+1;
+      next->len = 0;
+      next->first = node->first;
+    }
+
+    if(pos+3 > inLen)
+      continue;
+
+    uint32_t limit = min(blockLen-i, OPT_MAX_LEN);
+
+    // two byte matches only exist right after a short literal run
+    if(r >= 1 && r <= 3 && limit >= 2) {
+      uint32_t stored = w->head2[read16(in+pos)];
+
+      if(stored >= w->base && pos-(stored-w->base) <= M1_MAX_OFFSET)
+        relax(&nodes[i+2], node->cost+2, 2, pos-(stored-w->base));
+    }
+
+    if(pos >= skipUntil && limit >= 3) {
+      size_t num = find_matches(w, in, pos, limit, level);
+      uint32_t len = 3;
+      size_t k;
+
+      for(k = 0; k < num; k++) {
+        struct lzo1x_opt_match * m = &w->matches[k];
+
+        for(; len <= m->len; len++)
+          relax(&nodes[i+len], node->cost + match_cost(len, m->off, r), len, m->off);
+      }
+
+      // long matches are simply taken, there is little to gain around them
+      if(num > 0 && w->matches[num-1].len >= level->niceLen)
+        skipUntil = pos + w->matches[num-1].len;
+    }
+
+    insert(w, in, pos);
+  }
+
+  // walk back from the end of the block
+  size_t numSteps = 0;
+  i = blockLen;
+
+  while(i > 0) {
+    struct lzo1x_opt_node * node = &nodes[i];
+
+    if(node->len == 0) {
+      i--;
+      continue;
+    }
+
+    i -= node->len;
+    w->steps[numSteps].start = start+i;
+    w->steps[numSteps].len = node->len;
+    w->steps[numSteps].off = node->off;
+    numSteps++;
+  }
+
+  return numSteps;
+}
+
+int lzo1x_opt_compress(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen,
+    unsigned level, struct lzo1x_opt * w)
+{
+  const struct lzo1x_opt_level * lvl;
+  uint8_t * op = out;
+  uint32_t litStart = 0;
+  uint32_t start = 0;
+
+  if(inLen >= OPT_INFINITY/2)
+    return LZO_E_ERROR;
+
+  level = max(level, LZO1X_OPT_MIN_LEVEL);
+  level = min(level, LZO1X_OPT_MAX_LEVEL);
+  lvl = &levels[level-LZO1X_OPT_MIN_LEVEL];
+
+  if(inLen >= 0xffffffff-w->base)
+    reset(w);
+
+  while(start < inLen) {
+    uint32_t end = min(inLen, (size_t)start+OPT_BLOCK);
+    size_t numSteps = parse_block(w, in, inLen, start, end, start-litStart, op == out, lvl);
+
+    // the steps come out last to first
+    while(numSteps > 0) {
+      struct lzo1x_opt_step * s = &w->steps[--numSteps];
+      uint32_t litRun = s->start-litStart;
+
+      op = lzo1x_emit_literals(out, op, in+litStart, litRun, in+inLen);
+      op = lzo1x_emit_match(op, s->len, s->off, litRun);
+      litStart = s->start+s->len;
+    }
+
+    start = end;
+  }
+
+  op = lzo1x_emit_literals(out, op, in+litStart, inLen-litStart, in+inLen);
+  op = lzo1x_emit_end(op);
+
+  w->base += inLen+1;
+
+  *outLen = op-out;
+  return LZO_E_OK;
+}
@@ -0,0 +1,25 @@
+#ifndef LZO1X_OPT_H
+#define LZO1X_OPT_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// High ratio LZO1X compression in the spirit of LZO1X-999, which the
+// original packs were made with. The output is plain LZO1X and decodes with
+// lzo1x_decompress.
+
+#define LZO1X_OPT_MIN_LEVEL 2
+#define LZO1X_OPT_MAX_LEVEL 9
+
+// Work memory, reusable across calls but not shared between threads
+struct lzo1x_opt;
+
+struct lzo1x_opt * lzo1x_opt_alloc();
+void lzo1x_opt_free(struct lzo1x_opt * w);
+
+// `out` needs room for inLen + inLen/16 + 64 + 3 bytes. Higher levels search
+// further for matches and are slower.
+int lzo1x_opt_compress(const uint8_t * in, size_t inLen, uint8_t * out, size_t * outLen,
+    unsigned level, struct lzo1x_opt * w);
+
+#endif
@@ -0,0 +1,540 @@
+#include "pack.h"
+
+#include <assert.h>
+#include <string.h>
+
+#include "minilzo.h"
+#include "lzo1x_dec.h"
+#include "lzo1x_batch.h"
+#include "crc32.h"
+#include "util.h"
+#include "index.h"
+#include "fs.h"
+
+#ifdef PLATFORM_UNIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+// chunk size used when stored entries have to be copied through userspace
+#define COPY_CHUNK_SIZE (64*1024)
+
+// Set the magic constants used for packaging.
+const char PACK_MAGIC[4] = {'P', 'A', 'C', 'K'};
+const char LZO1_MAGIC[4] = {'L', 'Z', 'O', '1'};
+
+// Parses the object header at `data`, `size` being the size of the whole
+// object. The payload pointer is only usable when `data` covers all of it.
+bool lzo_object_parse(const uint8_t * data, uint32_t size, struct lzo_object * obj)
+{
+  assert(obj);
+
+  if(size < LZO_OBJECT_HEADER_SIZE)
+    return false;
+
+  if(memcmp(data+8, LZO1_MAGIC, sizeof(LZO1_MAGIC)) != 0)
+    return false;
+
+  memcpy(&obj->decompressedSize, data, 4);
+  memcpy(&obj->crc, data+4, 4);
+
+  obj->stored = (obj->decompressedSize & LZO_OBJECT_STORED) != 0;
+  obj->decompressedSize &= ~LZO_OBJECT_STORED;
+  obj->payload = data+LZO_OBJECT_HEADER_SIZE;
+  obj->payloadSize = size-LZO_OBJECT_HEADER_SIZE;
+
+  return true;
+}
+
+// Fills in the 12 byte object header at `data`
+void lzo_object_write_header(uint8_t * data, uint32_t decompressedSize, uint32_t crc, bool stored)
+{
+  if(stored)
+    decompressedSize |= LZO_OBJECT_STORED;
+
+  memcpy(data, &decompressedSize, 4);
+  memcpy(data+4, &crc, 4);
+  memcpy(data+8, LZO1_MAGIC, sizeof(LZO1_MAGIC));
+}
+
+// Packs come from anywhere, so by default nothing in them is trusted
+static enum lzo_decoder objectDecoder = LZO_DECODER_SAFE;
+
+static const char * const decoderNames[] = {
+  "minilzo",
+  "fast",
+  "safe"
+};
+
+void lzo_object_set_decoder(enum lzo_decoder decoder)
+{
+  objectDecoder = decoder;
+}
+
+enum lzo_decoder lzo_object_decoder()
+{
+  return objectDecoder;
+}
+
+bool lzo_decoder_from_name(const char * name, enum lzo_decoder * decoder)
+{
+  size_t i;
+
+  for(i = 0; i < sizeof(decoderNames)/sizeof(*decoderNames); i++) {
+    if(strcmp(name, decoderNames[i]) == 0) {
+      *decoder = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const char * lzo_decoder_name(enum lzo_decoder decoder)
+{
+  return decoderNames[decoder];
+}
+
+// Decodes the object into `out`, which must hold obj->decompressedSize bytes.
+// Returns an LZO_E_* code. When `crc` isn't NULL it is updated with the
+// CRC-32 of the output, which costs next to nothing with our own decoders.
+int lzo_object_decode(const struct lzo_object * obj, uint8_t * out, size_t * outSize, uint32_t * crc)
+{
+  if(obj->stored) {
+    size_t amt = min(obj->payloadSize, obj->decompressedSize);
+    size_t done;
+
+    // checksum each block right after copying it
+    for(done = 0; done < amt; done += LZO1X_CRC_BLOCK) {
+      size_t block = min(amt-done, LZO1X_CRC_BLOCK);
+
+      memcpy(out+done, obj->payload+done, block);
+
+      if(crc)
+        *crc = crc32_update(*crc, out+done, block);
+    }
+
+    *outSize = amt;
+
+    return amt == obj->decompressedSize ? LZO_E_OK : LZO_E_INPUT_OVERRUN;
+  }
+
+  if(objectDecoder == LZO_DECODER_SAFE) {
+    *outSize = obj->decompressedSize;
+
+    return lzo1x_decompress_fast_safe_crc(obj->payload, obj->payloadSize, out, outSize, crc);
+  }
+
+  if(objectDecoder == LZO_DECODER_FAST) {
+    *outSize = obj->decompressedSize;
+
+    return lzo1x_decompress_fast_crc(obj->payload, obj->payloadSize, out, outSize, crc);
+  }
+
+  lzo_uint newSize = obj->decompressedSize;
+  int r = lzo1x_decompress(obj->payload, obj->payloadSize, out, &newSize, NULL);
+
+  *outSize = newSize;
+
+  if(crc && r == LZO_E_OK)
+    *crc = crc32_update(*crc, out, newSize);
+
+  return r;
+}
+
+// Decodes many small objects at once. Our own decoders take the compressed
+// ones in turns on this thread, see lzo1x_batch.h. Stored and tiny objects,
+// and everything for the miniLZO decoder, go one at a time.
+void lzo_object_decode_batch(struct lzo_object_decode_job * jobs, size_t numJobs)
+{
+  struct lzo1x_stream streams[LZO_OBJECT_BATCH_ENTRIES];
+  struct lzo_object_decode_job * pending[LZO_OBJECT_BATCH_ENTRIES];
+  size_t i, num = 0;
+
+  assert(numJobs <= LZO_OBJECT_BATCH_ENTRIES);
+
+  for(i = 0; i < numJobs; i++) {
+    struct lzo_object_decode_job * job = &jobs[i];
+
+    if(job->obj.stored || job->obj.decompressedSize < LZO_OBJECT_LANE_MIN_SIZE ||
+        objectDecoder == LZO_DECODER_MINILZO) {
+      job->result = lzo_object_decode(&job->obj, job->out, &job->outSize, job->crc);
+      continue;
+    }
+
+    streams[num].in = job->obj.payload;
+    streams[num].inLen = job->obj.payloadSize;
+    streams[num].out = job->out;
+    streams[num].outLen = job->obj.decompressedSize;
+    streams[num].crc = job->crc;
+    pending[num++] = job;
+  }
+
+  if(objectDecoder == LZO_DECODER_FAST)
+    lzo1x_decompress_batch(streams, num);
+  else
+    lzo1x_decompress_batch_safe(streams, num);
+
+  for(i = 0; i < num; i++) {
+    pending[i]->outSize = streams[i].outLen;
+    pending[i]->result = streams[i].result;
+  }
+}
+
+bool pack_reader_open(struct pack_reader * r, const char * path)
+{
+  assert(r);
+
+  r->path = path;
+  r->map = NULL;
+  r->fp = fopen(path, "rb");
+
+  if(!r->fp)
+    return false;
+
+  fseek(r->fp, 0, SEEK_END);
+  r->size = ftell(r->fp);
+  fseek(r->fp, 0, SEEK_SET);
+
+#ifdef PLATFORM_UNIX
+  posix_fadvise(fileno(r->fp), 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  // a failed mapping (e.g. a huge pack on a 32-bit host) just means we fall
+  // back to reading through the FILE handle
+  if(r->size > 0 && r->size <= SIZE_MAX) {
+    void * map = mmap(NULL, r->size, PROT_READ, MAP_SHARED, fileno(r->fp), 0);
+
+    if(map != MAP_FAILED) {
+      madvise(map, r->size, MADV_SEQUENTIAL);
+      r->map = map;
+    }
+  }
+#endif
+
+  return true;
+}
+
+void pack_reader_close(struct pack_reader * r)
+{
+#ifdef PLATFORM_UNIX
+  if(r->map)
+    munmap((void *)r->map, r->size);
+#endif
+
+  if(r->fp)
+    fclose(r->fp);
+
+  r->map = NULL;
+  r->fp = NULL;
+}
+
+// Tells the kernel we are about to read this range so it can start pulling it
+// in while we are still busy with the current one.
+void pack_reader_advise(struct pack_reader * r, uint64_t offset, uint64_t size)
+{
+#ifdef PLATFORM_UNIX
+  posix_fadvise(fileno(r->fp), offset, size, POSIX_FADV_WILLNEED);
+#endif
+}
+
+static bool pack_range_valid(struct pack_reader * r, uint64_t offset, uint64_t size)
+{
+  return offset <= r->size && size <= r->size-offset;
+}
+
+// `fp` is the handle to read through when the pack isn't mapped. Pass NULL to
+// have the cursor open its own handle the first time it needs one, which is
+// what every worker thread but the first does.
+void pack_cursor_init(struct pack_cursor * c, struct pack_reader * r, FILE * fp)
+{
+  memset(c, 0, sizeof(*c));
+
+  c->reader = r;
+  c->fp = fp;
+}
+
+void pack_cursor_free(struct pack_cursor * c)
+{
+  if(c->ownsFp)
+    fclose(c->fp);
+
+  scratch_free(&c->window);
+  scratch_free(&c->copy);
+
+  c->fp = NULL;
+}
+
+static FILE * pack_cursor_fp(struct pack_cursor * c)
+{
+  if(!c->fp) {
+    c->fp = fopen(c->reader->path, "rb");
+    c->ownsFp = true;
+
+    if(!c->fp)
+      fatal("could not open '%s' for reading", c->reader->path);
+  }
+
+  return c->fp;
+}
+
+static bool pack_cursor_in_window(struct pack_cursor * c, uint64_t offset, uint64_t size)
+{
+  return c->windowSize > 0 && offset >= c->windowOffset &&
+    offset+size <= c->windowOffset+c->windowSize;
+}
+
+// Reads a range of an unmapped pack into the window, which is only ever grown
+static bool pack_cursor_load(struct pack_cursor * c, uint64_t offset, size_t size)
+{
+  uint8_t * window = scratch_reserve(&c->window, size);
+  FILE * fp = pack_cursor_fp(c);
+
+  c->windowSize = 0;
+
+  fseek(fp, offset, SEEK_SET);
+
+  if(fread(window, 1, size, fp) != size)
+    return false;
+
+  c->windowOffset = offset;
+  c->windowSize = size;
+
+  return true;
+}
+
+// Reads a whole run of adjacent entries with a single sequential read so the
+// entries in it can be served from memory. Mapped packs don't need a window,
+// the run is just hinted to the kernel.
+void pack_cursor_prefetch(struct pack_cursor * c, uint64_t offset, size_t size)
+{
+  struct pack_reader * r = c->reader;
+
+  c->windowSize = 0;
+
+  if(!pack_range_valid(r, offset, size))
+    return;
+
+  if(r->map) {
+    pack_reader_advise(r, offset, size);
+    return;
+  }
+
+  pack_cursor_load(c, offset, size);
+}
+
+// Returns `size` bytes of the pack starting at `offset`, or NULL when the
+// range lies outside of the pack. Ranges are served from the mapping or the
+// read window, which is refilled when the range isn't already in it. The
+// pointer stays valid until the next call on this cursor.
+const uint8_t * pack_cursor_fetch(struct pack_cursor * c, uint64_t offset, size_t size)
+{
+  struct pack_reader * r = c->reader;
+
+  if(!pack_range_valid(r, offset, size))
+    return NULL;
+
+  if(r->map)
+    return r->map+offset;
+
+  if(!pack_cursor_in_window(c, offset, size) && !pack_cursor_load(c, offset, size))
+    return NULL;
+
+  return c->window.data+(offset-c->windowOffset);
+}
+
+// Hands back a range returned by pack_cursor_fetch. For mapped packs the
+// pages that lie entirely within the range are dropped so that the resident
+// size stays flat while walking through a large pack.
+void pack_cursor_release(struct pack_cursor * c, const uint8_t * data, uint64_t offset, size_t size)
+{
+  struct pack_reader * r = c->reader;
+
+  if(!data || !r->map)
+    return;
+
+#ifdef PLATFORM_UNIX
+  uint64_t page = sysconf(_SC_PAGESIZE);
+  uint64_t start = (offset+page-1) & ~(page-1);
+  uint64_t end = (offset+size) & ~(page-1);
+
+  if(end > start)
+    madvise((void *)(r->map+start), end-start, MADV_DONTNEED);
+#endif
+}
+
+// Whether fetching the range would be served from memory without refilling
+// the window, i.e. without invalidating what earlier fetches returned
+bool pack_cursor_resident(struct pack_cursor * c, uint64_t offset, uint64_t size)
+{
+  struct pack_reader * r = c->reader;
+
+  if(!pack_range_valid(r, offset, size))
+    return false;
+
+  return r->map || pack_cursor_in_window(c, offset, size);
+}
+
+// Copies `size` bytes at `offset` into `data`.
+bool pack_cursor_read(struct pack_cursor * c, uint64_t offset, void * data, size_t size)
+{
+  struct pack_reader * r = c->reader;
+
+  if(!pack_range_valid(r, offset, size))
+    return false;
+
+  if(r->map) {
+    memcpy(data, r->map+offset, size);
+    return true;
+  }
+
+  if(pack_cursor_in_window(c, offset, size)) {
+    memcpy(data, c->window.data+(offset-c->windowOffset), size);
+    return true;
+  }
+
+  FILE * fp = pack_cursor_fp(c);
+
+  fseek(fp, offset, SEEK_SET);
+
+  return fread(data, 1, size, fp) == size;
+}
+
+// Copies `size` bytes at `offset` of the pack to the start of the empty
+// output file `out`, in the kernel where possible.
+bool pack_cursor_copy(struct pack_cursor * c, uint64_t offset, size_t size, int out)
+{
+  struct pack_reader * r = c->reader;
+
+  if(!pack_range_valid(r, offset, size))
+    return false;
+
+  // already in memory, no point in asking the kernel to read it again
+  if(pack_cursor_in_window(c, offset, size))
+    return file_write_all(out, c->window.data+(offset-c->windowOffset), size);
+
+  size_t done = 0;
+
+  // the kernel advances out's file offset, so the fallbacks below pick up
+  // where it left off
+  done = file_copy_kernel(fileno(r->fp), offset, out, size);
+
+  if(done == size)
+    return true;
+
+  if(r->map) {
+    bool ok = file_write_all(out, r->map+offset+done, size-done);
+
+    pack_cursor_release(c, r->map+offset, offset, size);
+    return ok;
+  }
+
+  uint8_t * chunk = scratch_reserve(&c->copy, COPY_CHUNK_SIZE);
+  FILE * fp = pack_cursor_fp(c);
+
+  fseek(fp, offset+done, SEEK_SET);
+
+  while(done < size) {
+    size_t amt = min(size-done, COPY_CHUNK_SIZE);
+
+    if(fread(chunk, 1, amt, fp) != amt || !file_write_all(out, chunk, amt))
+      break;
+
+    done += amt;
+  }
+
+  return done == size;
+}
+
+struct pack_plan_key
+{
+  uint32_t offset;
+  size_t entry;
+};
+
+static int pack_plan_compare(const void * a, const void * b)
+{
+  const struct pack_plan_key * l = a;
+  const struct pack_plan_key * r = b;
+
+  if(l->offset != r->offset)
+    return l->offset < r->offset ? -1 : 1;
+
+  // keep the sort stable so equal offsets stay in index order
+  return l->entry < r->entry ? -1 : (l->entry > r->entry ? 1 : 0);
+}
+
+// Orders the entries by their position in the pack and groups neighbours into
+// runs of up to `maxRunSize` bytes that can be read with one sequential read.
+// `entries` limits the plan to a subset of the index, NULL means all of it.
+bool pack_plan_build(struct pack_plan * plan, struct pack_index * index, const size_t * entries, size_t numEntries,
+    uint64_t startOfEntries, uint64_t maxRunSize)
+{
+  assert(plan);
+
+  size_t n = entries ? numEntries : index->numEntries;
+  struct pack_plan_key * keys = malloc(max(n, 1)*sizeof(struct pack_plan_key));
+
+  plan->order = malloc(max(n, 1)*sizeof(size_t));
+  plan->runs = malloc(max(n, 1)*sizeof(struct pack_run));
+  plan->numRuns = 0;
+  plan->numEntries = n;
+
+  if(!keys || !plan->order || !plan->runs) {
+    free(keys);
+    pack_plan_free(plan);
+    return false;
+  }
+
+  size_t i;
+  for(i = 0; i < n; i++) {
+    keys[i].entry = entries ? entries[i] : i;
+    keys[i].offset = index->index[keys[i].entry].offset;
+  }
+
+  qsort(keys, n, sizeof(struct pack_plan_key), pack_plan_compare);
+
+  for(i = 0; i < n; i++)
+    plan->order[i] = keys[i].entry;
+
+  free(keys);
+
+  struct pack_run * run = NULL;
+
+  for(i = 0; i < n; i++) {
+    struct pack_index_entry * e = &index->index[plan->order[i]];
+    uint64_t offset = startOfEntries+e->offset;
+    uint64_t end = offset+e->compressedSize;
+
+    // join the previous run when this entry follows it closely enough that
+    // reading through the gap is cheaper than a seek
+    if(run && offset >= run->offset+run->size &&
+        offset-(run->offset+run->size) <= PACK_RUN_MAX_GAP &&
+        end-run->offset <= maxRunSize) {
+      run->size = end-run->offset;
+      run->count++;
+      continue;
+    }
+
+    run = &plan->runs[plan->numRuns++];
+    run->offset = offset;
+    run->size = e->compressedSize;
+    run->first = i;
+    run->count = 1;
+  }
+
+  return true;
+}
+
+void pack_plan_free(struct pack_plan * plan)
+{
+  free(plan->order);
+  free(plan->runs);
+
+  plan->order = NULL;
+  plan->runs = NULL;
+  plan->numRuns = 0;
+  plan->numEntries = 0;
+}
@@ -0,0 +1,146 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "util.h"
+
+extern const char PACK_MAGIC[4];
+extern const char LZO1_MAGIC[4];
+
+// Set the pack header structure/object values.
+struct pack_header
+{
+  uint8_t magic[4];
+  uint32_t version;
+  uint32_t compressed_index_size;
+  uint32_t decompressed_index_size;
+  uint32_t num_files;
+  uint32_t unk1;
+  uint32_t unk2;
+};
+
+// Every compressed object (the index and each entry) starts with a 12 byte
+// header: decompressed size, CRC and the LZO1 magic.
+#define LZO_OBJECT_HEADER_SIZE 12
+
+// The MSB of the decompressed size is set when no compression actually took place
+#define LZO_OBJECT_STORED 0x80000000
+
+struct lzo_object
+{
+  uint32_t decompressedSize;
+  uint32_t crc;
+  bool stored;
+  const uint8_t * payload;
+  uint32_t payloadSize;
+};
+
+// Which LZO1X decoder lzo_object_decode uses
+enum lzo_decoder
+{
+  LZO_DECODER_MINILZO, // lzo1x_decompress from miniLZO
+  LZO_DECODER_FAST,    // lzo1x_decompress_fast, trusts the pack
+  LZO_DECODER_SAFE     // lzo1x_decompress_fast_safe, the default
+};
+
+// Entries that decompress to at most this many bytes are worth decoding in
+// batches, bigger ones keep a core busy on their own
+#define LZO_OBJECT_BATCH_MAX_SIZE (64*1024)
+
+// Most entries one lzo_object_decode_batch call takes
+#define LZO_OBJECT_BATCH_ENTRIES 32
+
+// Objects that decompress to fewer bytes are done before taking turns with
+// others pays for itself, they are decoded one at a time
+#define LZO_OBJECT_LANE_MIN_SIZE 128
+
+struct lzo_object_decode_job
+{
+  struct lzo_object obj;
+  uint8_t * out;  // room for obj.decompressedSize bytes
+  size_t outSize; // the decoded size once done
+  int result;     // an LZO_E_* code
+  uint32_t * crc; // updated with the CRC-32 of the output unless NULL
+};
+
+// Version written into the header of packs we create
+#define PACK_VERSION 1
+
+bool lzo_object_parse(const uint8_t * data, uint32_t size, struct lzo_object * obj);
+void lzo_object_write_header(uint8_t * data, uint32_t decompressedSize, uint32_t crc, bool stored);
+int lzo_object_decode(const struct lzo_object * obj, uint8_t * out, size_t * outSize, uint32_t * crc);
+void lzo_object_decode_batch(struct lzo_object_decode_job * jobs, size_t numJobs);
+void lzo_object_set_decoder(enum lzo_decoder decoder);
+enum lzo_decoder lzo_object_decoder();
+bool lzo_decoder_from_name(const char * name, enum lzo_decoder * decoder);
+const char * lzo_decoder_name(enum lzo_decoder decoder);
+
+// Read access to a pack file. When possible the whole pack is mapped once and
+// entries are handed out as pointers straight into the mapping, otherwise
+// they are read through a FILE handle.
+struct pack_reader
+{
+  const char * path;
+  FILE * fp;
+  uint64_t size;
+  const uint8_t * map;
+};
+
+// A single thread's view of a pack_reader. Unmapped packs are read through
+// the cursor's own handle, optionally a whole run of entries at a time.
+struct pack_cursor
+{
+  struct pack_reader * reader;
+  FILE * fp;
+  bool ownsFp;
+  struct scratch window;
+  uint64_t windowOffset;
+  size_t windowSize;
+  struct scratch copy;
+};
+
+// Runs are at most this large by default, and gaps up to this size are read through
+#define PACK_RUN_MAX_SIZE (8*1024*1024)
+#define PACK_RUN_MAX_GAP (64*1024)
+
+struct pack_run
+{
+  uint64_t offset;
+  uint64_t size;
+  size_t first; // into pack_plan.order
+  size_t count;
+};
+
+// The order to read a pack's entries in: ascending offset, grouped in runs
+struct pack_plan
+{
+  size_t * order; // indexes into pack_index.index
+  size_t numEntries;
+  struct pack_run * runs;
+  size_t numRuns;
+};
+
+struct pack_index;
+
+bool pack_reader_open(struct pack_reader * r, const char * path);
+void pack_reader_close(struct pack_reader * r);
+void pack_reader_advise(struct pack_reader * r, uint64_t offset, uint64_t size);
+
+void pack_cursor_init(struct pack_cursor * c, struct pack_reader * r, FILE * fp);
+void pack_cursor_free(struct pack_cursor * c);
+void pack_cursor_prefetch(struct pack_cursor * c, uint64_t offset, size_t size);
+const uint8_t * pack_cursor_fetch(struct pack_cursor * c, uint64_t offset, size_t size);
+void pack_cursor_release(struct pack_cursor * c, const uint8_t * data, uint64_t offset, size_t size);
+bool pack_cursor_resident(struct pack_cursor * c, uint64_t offset, uint64_t size);
+bool pack_cursor_read(struct pack_cursor * c, uint64_t offset, void * data, size_t size);
+bool pack_cursor_copy(struct pack_cursor * c, uint64_t offset, size_t size, int out);
+
+bool pack_plan_build(struct pack_plan * plan, struct pack_index * index, const size_t * entries, size_t numEntries,
+    uint64_t startOfEntries, uint64_t maxRunSize);
+void pack_plan_free(struct pack_plan * plan);
+
+#endif
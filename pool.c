@@ -0,0 +1,153 @@
+#include "pool.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "compat.h"
+#include "util.h"
+
+#ifdef PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+struct pool_state {
+  pool_work_fn fn;
+  void * ctx;
+  size_t numItems;
+  volatile size_t next;
+};
+
+struct pool_task {
+  pool_task_fn fn;
+  void * arg;
+  pthread_t thread;
+};
+
+struct pool_thread {
+  struct pool_state * state;
+  unsigned worker;
+  pthread_t thread;
+};
+
+unsigned pool_cpu_count()
+{
+#ifdef PLATFORM_WINDOWS
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+
+  return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return n > 0 ? (unsigned)n : 1;
+#endif
+}
+
+// 0 means "one per CPU" and there is no point in having more workers than items
+unsigned pool_clamp_workers(unsigned numWorkers, size_t numItems)
+{
+  if(numWorkers == 0)
+    numWorkers = pool_cpu_count();
+
+  if(numWorkers > numItems)
+    numWorkers = numItems;
+
+  return numWorkers > 0 ? numWorkers : 1;
+}
+
+static void pool_drain(struct pool_state * state, unsigned worker)
+{
+  while(true) {
+    // items are handed out one at a time; entries vary wildly in size so
+    // this balances better than splitting the range up front
+    size_t item = __sync_fetch_and_add(&state->next, 1);
+
+    if(item >= state->numItems)
+      break;
+
+    state->fn(state->ctx, worker, item);
+  }
+}
+
+static void * pool_thread_main(void * arg)
+{
+  struct pool_thread * t = arg;
+
+  pool_drain(t->state, t->worker);
+
+  return NULL;
+}
+
+void pool_run(unsigned numWorkers, size_t numItems, pool_work_fn fn, void * ctx)
+{
+  struct pool_state state;
+  state.fn = fn;
+  state.ctx = ctx;
+  state.numItems = numItems;
+  state.next = 0;
+
+  numWorkers = pool_clamp_workers(numWorkers, numItems);
+
+  // the serial case doesn't need any threads at all
+  if(numWorkers == 1) {
+    pool_drain(&state, 0);
+    return;
+  }
+
+  struct pool_thread * threads = calloc(numWorkers, sizeof(struct pool_thread));
+
+  if(!threads)
+    fatal("failed to allocate worker threads");
+
+  // the calling thread acts as worker 0
+  unsigned i;
+  for(i = 1; i < numWorkers; i++) {
+    threads[i].state = &state;
+    threads[i].worker = i;
+
+    if(pthread_create(&threads[i].thread, NULL, pool_thread_main, &threads[i]) != 0)
+      fatal("failed to start worker thread %u", i);
+  }
+
+  pool_drain(&state, 0);
+
+  for(i = 1; i < numWorkers; i++)
+    pthread_join(threads[i].thread, NULL);
+
+  free(threads);
+}
+
+static void * pool_task_main(void * arg)
+{
+  struct pool_task * task = arg;
+
+  task->fn(task->arg);
+
+  return NULL;
+}
+
+// Runs fn(arg) on a new thread. Every task must be finished with pool_wait.
+struct pool_task * pool_async(pool_task_fn fn, void * arg)
+{
+  struct pool_task * task = malloc(sizeof(struct pool_task));
+
+  if(!task)
+    fatal("failed to allocate background task");
+
+  task->fn = fn;
+  task->arg = arg;
+
+  if(pthread_create(&task->thread, NULL, pool_task_main, task) != 0)
+    fatal("failed to start background thread");
+
+  return task;
+}
+
+void pool_wait(struct pool_task * task)
+{
+  pthread_join(task->thread, NULL);
+  free(task);
+}
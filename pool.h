@@ -0,0 +1,20 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+// Called once for every work item. `worker` is the index (0..numWorkers-1)
+// of the calling thread so callers can keep per-worker state in an array.
+typedef void (*pool_work_fn)(void * ctx, unsigned worker, size_t item);
+
+// A single background job, for work that should overlap with pool_run
+typedef void (*pool_task_fn)(void * arg);
+struct pool_task;
+
+unsigned pool_cpu_count();
+unsigned pool_clamp_workers(unsigned numWorkers, size_t numItems);
+void pool_run(unsigned numWorkers, size_t numItems, pool_work_fn fn, void * ctx);
+struct pool_task * pool_async(pool_task_fn fn, void * arg);
+void pool_wait(struct pool_task * task);
+
+#endif
@@ -1,11 +1,15 @@
 // Include standard libraries.
+#include <assert.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <memory.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
 
 // Include local libraries.
 #include "asprintf.h"
@@ -14,6 +18,17 @@
 #include "fs.h"
 #include "util.h"
 #include "prompt.h"
+#include "pool.h"
+#include "pack.h"
+#include "uring.h"
+#include "tar.h"
+#include "create.h"
+#include "index_cache.h"
+#include "index_names.h"
+#include "verify.h"
+#include "lzo1x_opt.h"
+#include "lzo1x_dec.h"
+#include "crc32.h"
 
 //////////// GLOBALS
 // Define various pack versions for their respectable repositories.
@@ -21,44 +36,160 @@
 #define VERSION_MINOR 0
 #define VERSION_REVISION 0
 
-// Set the magic constants used for packaging.
-const char PACK_MAGIC[4] = {'P', 'A', 'C', 'K'};
-const char LZO1_MAGIC[4] = {'L', 'Z', 'O', '1'};
 int g_verbose = 0;
 int g_debug = 0;
+unsigned g_jobs = 1;
+unsigned g_level = 0; // compression level, 0 for the default of the method
+bool g_uring = false;
+bool g_mapOutput = false;
+int g_tarFd = -1;
+bool g_checkCrc = true;
+bool g_indexCache = false;
 
-//////////// FUNCTIONS
-void banner();
-bool extractPack(char * path);
-bool carve_lzo(FILE * fp, uint32_t compressedSize, char ** decompressed, size_t * decompressedSize);
-bool carve_lzo_to_file(FILE * fp, const char * name, uint32_t compressedSize);
+// Entries whose contents didn't match their CRC-32, counted by all workers
+size_t g_crcErrors = 0;
 
-//////////// TYPES
-// Set the pack header structure/object values.
-struct pack_header
-{
-  uint8_t magic[4];
-  uint32_t version;
-  uint32_t compressed_index_size;
-  uint32_t decompressed_index_size;
-  uint32_t num_files;
-  uint32_t unk1;
-  uint32_t unk2;
-};
+// Names or patterns of the entries to extract, all of them when empty
+char ** g_select = NULL;
+size_t g_numSelect = 0;
+
+// Longest output path we are willing to build for an entry
+#define EXTRACT_PATH_MAX 4096
+
+// Number of entries every io_uring worker keeps in flight
+#define URING_DEPTH 16
+
+// Tar streams are decompressed in batches of at most this many entries or
+// bytes. The workers fill one batch while the previous one is written out.
+#define TAR_BATCH_ENTRIES 64
+#define TAR_BATCH_BYTES (32*1024*1024)
 
+//////////// TYPES
 enum pack_method
 {
   METHOD_NONE,
   METHOD_EXTRACT,
-  METHOD_CREATE
+  METHOD_CREATE,
+  METHOD_OPTIMIZE,
+  METHOD_VERIFY,
+  METHOD_LIST
+};
+
+// Per-thread extraction state. When the pack could not be mapped every worker
+// reads through its own cursor so that seeking never races with another
+// worker's reads.
+struct extract_worker
+{
+  struct pack_cursor cursor;
+  struct scratch output;
+  struct scratch batchOutput;
+  char outName[EXTRACT_PATH_MAX];
+};
+
+struct extract_job
+{
+  struct pack_reader * reader;
+  const char * dirName;
+  size_t startOfEntries;
+  struct pack_index * index;
+  struct pack_plan plan;
+  unsigned numWorkers;
+  struct extract_worker * workers;
+  uint64_t mtime;
+};
+
+struct tar_item
+{
+  size_t entry;
+  const uint8_t * data;
+  size_t size;
+  struct scratch buf;
+  const uint8_t * object; // set when data points into the pack's mapping
+  uint64_t objectOffset;
+  size_t objectSize;
+};
+
+// Items are decoded in groups, small neighbours share one
+struct tar_batch
+{
+  struct extract_job * job;
+  struct tar_item items[TAR_BATCH_ENTRIES];
+  size_t count;
+  size_t groups[TAR_BATCH_ENTRIES+1]; // first item of every group
+  size_t numGroups;
+};
+
+#ifdef HAVE_URING
+// Where an entry is in the io_uring pipeline. Each slot has at most one
+// operation in flight, so the slot number doubles as the completion tag.
+enum uring_slot_state
+{
+  SLOT_FREE,
+  SLOT_READING,
+  SLOT_READ,
+  SLOT_OPENING,
+  SLOT_WRITING,
+  SLOT_CLOSING
 };
 
+struct uring_slot
+{
+  enum uring_slot_state state;
+  size_t entry;
+  struct scratch in;
+  struct scratch out;
+  const uint8_t * data; // what ends up in the output file
+  size_t size;
+  size_t done;
+  int fd;
+  char outName[EXTRACT_PATH_MAX];
+};
+#endif
+
+//////////// FUNCTIONS
+void banner();
+bool extractPack(char * path);
+bool createPack(char * path);
+bool optimizePack(char * path);
+bool verifyPack(char * path);
+bool listPack(char * path);
+void extract_run(void * ctx, unsigned worker, size_t item);
+void extract_entry(struct extract_job * job, struct extract_worker * w, size_t entry);
+void extract_print_entry(const struct pack_index * index, struct pack_index_entry * e, size_t entry);
+bool entry_batchable(struct extract_job * job, size_t entry);
+size_t extract_batch_size(struct extract_job * job, struct extract_worker * w, struct pack_run * run, size_t first);
+void extract_entry_batch(struct extract_job * job, struct extract_worker * w, const size_t * entries, size_t count);
+void decode_entry_batch(struct extract_job * job, struct pack_cursor * c, const size_t * entries, size_t count,
+    struct scratch * out, const uint8_t ** data, size_t * sizes);
+void add_selection(const char * pattern);
+size_t * select_entries(struct pack_index * index, size_t * numSelected);
+bool selection_exact();
+size_t * select_entries_lazy(struct pack_index_lazy * lazy, size_t * numSelected);
+size_t list_entries(const struct pack_index * index, const struct pack_names * names);
+void extract_to_tar(struct extract_job * job, int fd);
+void tar_group_batch(struct tar_batch * batch);
+void tar_decode_group(void * ctx, unsigned worker, size_t group);
+void tar_decode_item(void * ctx, unsigned worker, size_t item);
+void tar_write_batch(void * arg);
+#ifdef HAVE_URING
+void extract_lane_uring(void * ctx, unsigned worker, size_t lane);
+void uring_slot_start(struct extract_job * job, struct uring * u, struct uring_slot * slot, unsigned idx, size_t entry);
+void uring_slot_decode(struct extract_job * job, struct uring * u, struct uring_slot * slot, unsigned idx);
+void uring_slot_complete(struct extract_job * job, struct uring * u, struct uring_slot * slot, unsigned idx, int res);
+#endif
+bool check_crc(const struct pack_index * index, struct pack_index_entry * e, uint64_t offset, uint32_t objectCrc, uint32_t crc);
+bool check_crc_data(const struct pack_index * index, struct pack_index_entry * e, uint64_t offset, uint32_t objectCrc, const uint8_t * data, size_t size);
+bool carve_lzo(struct pack_cursor * c, const struct pack_index * index, struct pack_index_entry * e, uint64_t offset, uint32_t compressedSize, struct scratch * decompressed, size_t * decompressedSize);
+bool carve_lzo_to_file(struct pack_cursor * c, const struct pack_index * index, struct pack_index_entry * e, uint64_t offset, uint32_t compressedSize, const char * name, struct scratch * decompressed);
+bool carve_lzo_to_mapped_file(struct pack_cursor * c, const struct pack_index * index, struct pack_index_entry * e, uint64_t offset, uint32_t compressedSize, int outFile, struct scratch * decompressed);
+
 int main(int argc, char ** argv)
 {
 	// Define the variables needed to handle getopt.
 	int	args;
 	enum pack_method method = METHOD_NONE;
 	char * arguments = NULL;
+	bool tarOutput = false;
 
 	if(!is_terminal(stdout))
 	{
@@ -73,10 +204,19 @@ int main(int argc, char ** argv)
                       setvbuf(stdout, NULL, _IOLBF, 4096);
         }
 
-	banner();
+	// Long options that have no single letter equivalent
+	enum { OPT_FROM_LIST = 256, OPT_DECODER, OPT_NO_CRC, OPT_INDEX_CACHE };
+
+	static const struct option longOptions[] = {
+		{"from-list", required_argument, NULL, OPT_FROM_LIST},
+		{"decoder", required_argument, NULL, OPT_DECODER},
+		{"no-crc", no_argument, NULL, OPT_NO_CRC},
+		{"index-cache", no_argument, NULL, OPT_INDEX_CACHE},
+		{NULL, 0, NULL, 0}
+	};
 
 	// While there are arguments passed into the system.
-	while ((args = getopt(argc, argv, ":dvc:x:")) != -1)
+	while ((args = getopt_long(argc, argv, ":dvumOc:x:o:t:L:j:l:", longOptions, NULL)) != -1)
 	{
 		switch (args)
 		{
@@ -97,6 +237,33 @@ int main(int argc, char ** argv)
 			// Assign additional arguments.
 			arguments = strdup(optarg);
 
+			break;
+		// case 'optimize':
+		case 'o':
+			// Assign the pack method.
+			method = METHOD_OPTIMIZE;
+
+			// Assign additional arguments.
+			arguments = strdup(optarg);
+
+			break;
+		// case 'test':
+		case 't':
+			// Assign the pack method.
+			method = METHOD_VERIFY;
+
+			// Assign additional arguments.
+			arguments = strdup(optarg);
+
+			break;
+		// case 'list':
+		case 'L':
+			// Assign the pack method.
+			method = METHOD_LIST;
+
+			// Assign additional arguments.
+			arguments = strdup(optarg);
+
 			break;
 		case 'v':
 			g_verbose++;
@@ -104,15 +271,107 @@ int main(int argc, char ** argv)
 		case 'd':
 			g_debug++;
 			break;
+		case 'j':
+			// Zero means one worker per CPU.
+			g_jobs = strtoul(optarg, NULL, 10);
+			break;
+		case 'l':
+			g_level = strtoul(optarg, NULL, 10);
+
+			if(g_level < 1 || g_level > LZO1X_OPT_MAX_LEVEL) {
+				fatal("Compression level must be between 1 and %d", LZO1X_OPT_MAX_LEVEL);
+			}
+			break;
+		case 'u':
+			g_uring = true;
+			break;
+		case 'm':
+			g_mapOutput = true;
+			break;
+		case 'O':
+			tarOutput = true;
+			break;
+		case OPT_FROM_LIST:
+		{
+			char ** lines = NULL;
+			size_t numLines = 0;
+
+			if(!file_read_lines(optarg, &lines, &numLines)) {
+				fatal("could not read list file '%s'", optarg);
+			}
+
+			size_t i;
+			for(i = 0; i < numLines; i++) {
+				add_selection(lines[i]);
+			}
+
+			free(lines);
+			break;
+		}
+		case OPT_DECODER:
+		{
+			enum lzo_decoder decoder;
+
+			if(!lzo_decoder_from_name(optarg, &decoder)) {
+				fatal("Unknown decoder '%s', use safe, fast or minilzo", optarg);
+			}
+
+			lzo_object_set_decoder(decoder);
+			break;
+		}
+		case OPT_NO_CRC:
+			g_checkCrc = false;
+			break;
+		case OPT_INDEX_CACHE:
+			g_indexCache = true;
+			break;
+		// optopt is only set for single letter options
 		case '?':
+			if(optopt == 0)
+				fatal("Unknown option '%s'", argv[optind-1]);
+
 			fatal("Unknown option '%c'", optopt);
 			break;
 		case ':':
+			if(optopt == 0 || optopt >= OPT_FROM_LIST)
+				fatal("Missing required argument for '%s'", argv[optind-1]);
+
 			fatal("Missing required argument for '%c'", optopt);
 			break;
 		}
 	}
 
+	// Anything after the options names entries to extract
+	for(; optind < argc; optind++)
+	{
+		add_selection(argv[optind]);
+	}
+
+	if(g_numSelect > 0 && method != METHOD_EXTRACT && method != METHOD_LIST)
+	{
+		fatal("Entries can only be selected when extracting (-x) or listing (-L)");
+	}
+
+	// The archive gets standard output to itself, everything else goes to stderr
+	if(tarOutput)
+	{
+		if(method != METHOD_EXTRACT) {
+			fatal("Streaming as tar requires a pack to extract (-x)");
+		}
+
+		if(is_terminal(stdout)) {
+			fatal("Refusing to write a tar stream to a terminal");
+		}
+
+		g_tarFd = file_take_stdout();
+
+		if(g_tarFd < 0) {
+			fatal("failed to take over standard output");
+		}
+	}
+
+	banner();
+
 	// If there is no pack method defined.
 	if (method == METHOD_NONE)
 	{
@@ -169,7 +428,24 @@ int main(int argc, char ** argv)
 	}
 	else if(method == METHOD_CREATE)
 	{
-		fatal("We cannot yet create a pack.");
+		// Run the packer.
+		createPack(arguments);
+	}
+	else if(method == METHOD_OPTIMIZE)
+	{
+		// Recompress the pack.
+		optimizePack(arguments);
+	}
+	else if(method == METHOD_VERIFY)
+	{
+		// Check every entry without writing anything.
+		if(!verifyPack(arguments))
+			return 1;
+	}
+	else if(method == METHOD_LIST)
+	{
+		// Print the names in order.
+		listPack(arguments);
 	}
 
 	return 0;
@@ -188,9 +464,63 @@ void banner()
 	printf("       \\/\n\n");
 }
 
-bool extractPack(char * path)
+bool createPack(char * path)
+{
+	char * dirName = NULL;
+
+	// If there is no path.
+	if (!path)
+	{
+		// Prompt the user for input.
+		dirName = prompt_string("Please provide the path of the folder to pack: ");
+		if(!dirName)
+		{
+		  fatal("failed to read folder path");
+		}
+	} else {
+		dirName = path;
+	}
+
+	// Trailing separators would leave the pack inside the folder
+	size_t len = strlen(dirName);
+	while(len > 1 && (dirName[len-1] == '/' || dirName[len-1] == PATH_SEP[0])) {
+		dirName[--len] = '\0';
+	}
+
+	if(!dir_exists(dirName)) {
+		fatal("'%s' is not a folder", dirName);
+	}
+
+	// Undo the "-out" suffix extraction adds, otherwise name the pack after the folder
+	char * packName = NULL;
+
+	if(len > 4 && strcmp(dirName+len-4, "-out") == 0) {
+		packName = strdup(dirName);
+		packName[len-4] = '\0';
+	} else {
+		packName = string_cat(dirName, ".pak");
+	}
+
+	if(file_exists(packName)) {
+		warning("overwriting %s", packName);
+	}
+
+	struct create_options opts;
+	opts.jobs = g_jobs;
+	opts.verbose = g_verbose;
+	opts.verify = g_debug >= 1;
+	opts.level = g_level ? g_level : CREATE_DEFAULT_LEVEL;
+	opts.uring = g_uring;
+
+	bool ok = create_pack(dirName, packName, &opts);
+
+	free(packName);
+
+	return ok;
+}
+
+bool optimizePack(char * path)
 {
-	// Define variables necessary to compute pack extraction.
 	char * packFileName = NULL;
 
 	// If there is no path.
@@ -206,15 +536,69 @@ bool extractPack(char * path)
 		packFileName = path;
 	}
 
-	FILE * pFile = fopen(packFileName, "rb");
+	struct create_options opts;
+	opts.jobs = g_jobs;
+	opts.verbose = g_verbose;
+	opts.verify = g_debug >= 1;
+	opts.level = g_level ? g_level : OPTIMIZE_DEFAULT_LEVEL;
+	opts.uring = g_uring;
 
-	if(!pFile) {
+	return optimize_pack(packFileName, &opts);
+}
+
+bool verifyPack(char * path)
+{
+	char * packFileName = NULL;
+
+	// If there is no path.
+	if (!path)
+	{
+		// Prompt the user for input.
+		packFileName = prompt_string("Please provide the path of the pack (.PAK) file: ");
+		if(!packFileName)
+		{
+		  fatal("failed to read PAK path");
+		}
+	} else {
+		packFileName = path;
+	}
+
+	struct verify_options opts;
+	opts.jobs = g_jobs;
+	opts.verbose = g_verbose;
+
+	return verify_pack(packFileName, &opts);
+}
+
+bool listPack(char * path)
+{
+	char * packFileName = NULL;
+
+	// If there is no path.
+	if (!path)
+	{
+		// Prompt the user for input.
+		packFileName = prompt_string("Please provide the path of the pack (.PAK) file: ");
+		if(!packFileName)
+		{
+		  fatal("failed to read PAK path");
+		}
+	} else {
+		packFileName = path;
+	}
+
+	struct pack_reader reader;
+
+	if(!pack_reader_open(&reader, packFileName)) {
 		fatal("could not open '%s' for reading", packFileName);
 	}
 
+	struct pack_cursor cursor;
 	struct pack_header header;
 
-	if(fread(&header, sizeof(header), 1, pFile) != 1) {
+	pack_cursor_init(&cursor, &reader, reader.fp);
+
+	if(!pack_cursor_read(&cursor, 0, &header, sizeof(header))) {
 		fatal("PACK file too small (not enough bytes for the complete header)");
 	}
 
@@ -222,198 +606,1429 @@ bool extractPack(char * path)
 		fatal("PACK has invalid magic");
 	}
 
-	if(g_debug >= 1)
+	struct pack_index index;
+	struct pack_index_cache_key cacheKey;
+	struct scratch indexScratch = {0};
+	bool useCache = g_indexCache && pack_index_cache_key_read(&cacheKey, &cursor, &header);
+	bool cached = useCache && pack_index_cache_load(packFileName, &cacheKey, &index);
+
+	if(!cached)
 	{
-		printf("PACK v.%"PRIu32", 0x%"PRIx32", 0x%"PRIx32"\n",
-		    header.version, header.unk1, header.unk2);
-	}
+		size_t indexDataSize = 0;
 
-	char * indexData = NULL;
-	size_t indexDataSize = 0;
+		if(!carve_lzo(&cursor, NULL, NULL, sizeof(header), header.compressed_index_size, &indexScratch, &indexDataSize)) {
+			fatal("failed to decompress PACK index");
+		}
 
-	if(!carve_lzo(pFile, header.compressed_index_size, &indexData, &indexDataSize)) {
-		fatal("failed to decompress PACK index");
-	}
+		if(!pack_index_parse((char *)indexScratch.data, indexDataSize, &index, g_jobs)) {
+			fatal("failed to parse PACK index");
+		}
 
-	if(indexDataSize != header.decompressed_index_size) {
-		warning("PACK header's decompressed index size (%"PRIu32") != actual index size (%"PRIuSZT")",
-		    header.decompressed_index_size, indexDataSize);
+		if(useCache && !pack_index_cache_store(packFileName, &cacheKey, &index)) {
+			warning("could not write the index cache %s%s", packFileName, PACK_INDEX_CACHE_SUFFIX);
+		}
 	}
 
-	size_t startOfEntries = ftell(pFile);
+	struct pack_names names;
 
-	struct pack_index index;
-	if(!pack_index_parse(indexData, indexDataSize, &index)) {
-		fatal("failed to parse PACK index");
+	if(!pack_names_build(&names, &index)) {
+		fatal("failed to sort the PACK index names");
 	}
 
-	if(index.numEntries != header.num_files)
+	if(g_debug >= 1)
 	{
-	  warning("index has %"PRIuSZT" files, but pack header says we should have %"PRIu32,
-	      index.numEntries, header.num_files);
+		printf("PACK names front coded into %"PRIuSZT" bytes (%"PRIuSZT" as stored in the index)\n",
+		    names.dataSize, index.namesSize-index.numEntries*PACK_INDEX_FIELDS_SIZE);
 	}
 
-	char * dirName = NULL;
-	char *packBaseName = basename(packFileName, false);
-	asprintf(&dirName, "%s-out/", packBaseName);
-
-	printf("Extracting %"PRIu32" files to %s\n",
-	    header.num_files, dirName);
-
-	if(!create_dir(dirName)) {
-		fatal("failed to create output directory");
+	// names now come from the table, only the entries' fields are still needed
+	if(!cached)
+	{
+		scratch_free(&indexScratch);
+		index.names = NULL;
+		index.namesSize = 0;
 	}
 
-	int i;
-	for(i = 0; i < index.numEntries; i++) {
-		struct pack_index_entry * e = index.index[i];
-
-		if(g_verbose >= 1)
-		{
-			printf("{%d} %30s (compressed size %u -> %u, offset %6u, CRC-32 0x%08x, U1 %u, U3 %u)\n",
-				i+1, e->name, e->compressedSize, e->decompressedSize,
-				e->offset,
-				e->crc,
-				e->unk1,
-				e->unk3);
-		}
-
-		fseek(pFile, e->offset+startOfEntries, SEEK_SET);
+	size_t listed = list_entries(&index, &names);
 
-		char *outName = NULL;
-		asprintf(&outName, "./%s%s", dirName, e->name);
+	pack_names_free(&names);
+	pack_index_free(&index);
+	pack_cursor_free(&cursor);
+	pack_reader_close(&reader);
 
-		if(e->compressedSize > 0) {
-			if(!carve_lzo_to_file(pFile, outName, e->compressedSize)) {
-				fatal("failed to unpack file %s", e->name);
-			}
-		} else {
-			FILE * fp = fopen(outName, "wb"); // create a blank file
-			fclose(fp);
-		}
+	if(g_numSelect > 0 && listed == 0)
+	{
+		fatal("no entries match the selection");
 	}
 
-	return 0;
+	return true;
 }
 
-bool carve_lzo(FILE * fp, uint32_t compressedSize, char ** decompressed, size_t * decompressedSize)
+bool extractPack(char * path)
 {
-  uint32_t lzoCRC = 0;
-  char lzoMagic[4] = {0};
-
-  // nothing to decompress, just skip the entry and signal an error
-  if(compressedSize == 0)
-  {
-    *decompressed = NULL;
-    *decompressedSize = 0;
-    return false;
-  }
-
-  long start = ftell(fp);
+	// Define variables necessary to compute pack extraction.
+	char * packFileName = NULL;
 
-  uint32_t localDecompressedSize;
-  if(fread(&localDecompressedSize, 4, 1, fp) != 1) { // decompressed size
-    return false;
-  }
+	// If there is no path.
+	if (!path)
+	{
+		// Prompt the user for input.
+		packFileName = prompt_string("Please provide the path of the pack (.PAK) file: ");
+		if(!packFileName)
+		{
+		  fatal("failed to read PAK path");
+		}
+	} else {
+		packFileName = path;
+	}
 
-  fread(&lzoCRC, 4, 1, fp); // CRC
-  fread(&lzoMagic, 1, 4, fp); // LZO magic
+	struct pack_reader reader;
 
-  if(memcmp(lzoMagic, LZO1_MAGIC, 4) != 0) {
-    fatal("LZO magic mismatch");
-  }
+	if(!pack_reader_open(&reader, packFileName)) {
+		fatal("could not open '%s' for reading", packFileName);
+	}
 
-  size_t adj = 4 + 8;
-  if(compressedSize < adj) {
-    fatal("compressed size too small, ds %"PRIu32, localDecompressedSize);
-  }
+	struct pack_cursor cursor;
+	struct pack_header header;
 
-  compressedSize -= adj;
+	pack_cursor_init(&cursor, &reader, reader.fp);
 
-  bool disableDecompression = false;
+	if(!pack_cursor_read(&cursor, 0, &header, sizeof(header))) {
+		fatal("PACK file too small (not enough bytes for the complete header)");
+	}
 
-  // The MSB of the decompressed size is set when no compression actually took place
-  if(localDecompressedSize & 0x80000000) {
-    localDecompressedSize &= ~0x80000000;
-    disableDecompression = true;
-  }
+	if(memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC))) {
+		fatal("PACK has invalid magic");
+	}
 
-  if(g_debug >= 1)
-  {
-	    printf("Extracting LZO object at 0x%ld (compressed %"PRIu32"+12, decompressed %"PRIu32" %"PRIx32")\n",
-		start, compressedSize, localDecompressedSize, localDecompressedSize);
-  }
+	if(g_debug >= 1)
+	{
+		printf("PACK v.%"PRIu32", 0x%"PRIx32", 0x%"PRIx32"%s\n",
+		    header.version, header.unk1, header.unk2,
+		    reader.map ? " (mapped)" : "");
+
+		if(lzo_object_decoder() != LZO_DECODER_MINILZO)
+			printf("LZO decoder: %s (%s)\n", lzo_decoder_name(lzo_object_decoder()),
+			    lzo1x_decompress_fast_variant());
+		else
+			printf("LZO decoder: %s\n", lzo_decoder_name(lzo_object_decoder()));
+
+		if(g_checkCrc)
+			printf("CRC-32: %s\n", crc32_implementation());
+	}
 
-  char * compressed = malloc(compressedSize);
+	size_t startOfEntries = sizeof(header)+header.compressed_index_size;
 
-  if(!compressed) {
-    fatal("failed to allocate compressed memory");
-  }
+	struct pack_index index;
+	struct pack_index_lazy lazyIndex;
+	struct pack_index_cache_key cacheKey;
+	struct scratch indexScratch = {0};
+	bool useCache = g_indexCache && pack_index_cache_key_read(&cacheKey, &cursor, &header);
+	bool cached = useCache && pack_index_cache_load(packFileName, &cacheKey, &index);
 
-  if(fread(compressed, sizeof(char), compressedSize, fp) != compressedSize) {
-    fatal("ran out of bytes when reading compressed data");
-  }
+	// Entries named exactly only need the index parsed as far as they are
+	bool lazy = !useCache && selection_exact();
 
-  if(disableDecompression) {
-    // Note: no need to free compressed as we are handing it off to the caller
-    *decompressed = compressed;
-    *decompressedSize = localDecompressedSize;
+	if(cached)
+	{
+		if(g_debug >= 1)
+			printf("PACK index loaded from %s%s\n", packFileName, PACK_INDEX_CACHE_SUFFIX);
+	}
+	else
+	{
+		size_t indexDataSize = 0;
 
-    return true;
-  } else {
-    uint32_t decompressedNewSize = localDecompressedSize;
-    char * localDecompressed = malloc(localDecompressedSize);
+		if(!carve_lzo(&cursor, NULL, NULL, sizeof(header), header.compressed_index_size, &indexScratch, &indexDataSize)) {
+			fatal("failed to decompress PACK index");
+		}
 
-    if(!localDecompressed) {
-      fatal("failed to allocate decompressed memory");
-    }
+		char * indexData = (char *)indexScratch.data;
 
-    int r = lzo1x_decompress((const unsigned char *)compressed, compressedSize, (unsigned char *)localDecompressed, &decompressedNewSize, NULL);
+		if(indexDataSize != header.decompressed_index_size) {
+			warning("PACK header's decompressed index size (%"PRIu32") != actual index size (%"PRIuSZT")",
+			    header.decompressed_index_size, indexDataSize);
+		}
 
-    // free compressed as we are done with that memory
-    free(compressed);
+		if(lazy) {
+			pack_index_lazy_init(&lazyIndex, indexData, indexDataSize);
+		} else if(!pack_index_parse(indexData, indexDataSize, &index, g_jobs)) {
+			fatal("failed to parse PACK index");
+		}
 
-    if (r == LZO_E_OK) {
-      //printf("decompressed %u bytes\n", decompressedNewSize);
+		// the pack is extracted anyway, a cache that can't be written is no reason to stop
+		if(useCache && !pack_index_cache_store(packFileName, &cacheKey, &index)) {
+			warning("could not write the index cache %s%s", packFileName, PACK_INDEX_CACHE_SUFFIX);
+		}
+	}
 
-      *decompressed = localDecompressed;
-      *decompressedSize = decompressedNewSize;
+	size_t * selection = NULL;
+	size_t numSelected = 0;
 
-      return true;
-    }
-    else
-    {
-      printf("LZO: internal error - decompression failed: %d\n", r);
+	if(lazy)
+	{
+		selection = select_entries_lazy(&lazyIndex, &numSelected);
 
-      if(g_debug >= 1)
-	printf("newSize %u, oldSize %u\n", decompressedNewSize, localDecompressedSize);
+		// nothing else is looked up, the entries parsed so far are all extraction needs
+		index = lazyIndex.index;
 
-      free(localDecompressed);
-      return false;
-    }
-  }
+		if(g_debug >= 1)
+			printf("PACK index parsed up to entry %"PRIuSZT"%s\n", index.numEntries,
+			    lazyIndex.complete ? " (all of it)" : "");
+	}
+	else if(g_numSelect > 0)
+	{
+		selection = select_entries(&index, &numSelected);
+	}
+	else
+	{
+		numSelected = index.numEntries;
+	}
+
+	if((!lazy || lazyIndex.complete) && index.numEntries != header.num_files)
+	{
+	  warning("index has %"PRIuSZT" files, but pack header says we should have %"PRIu32,
+	      index.numEntries, header.num_files);
+	}
+
+	if(g_numSelect > 0 && numSelected == 0)
+	{
+		fatal("no entries match the selection");
+	}
+
+	char * dirName = NULL;
+	char *packBaseName = basename(packFileName, false);
+	asprintf(&dirName, "%s-out/", packBaseName);
+
+	if(g_tarFd >= 0)
+	{
+		printf("Streaming %"PRIuSZT" files to standard output as tar\n",
+		    numSelected);
+	}
+	else
+	{
+		printf("Extracting %"PRIuSZT" files to %s\n",
+		    numSelected, dirName);
+
+		if(!create_dir(dirName)) {
+			fatal("failed to create output directory");
+		}
+	}
+
+	struct extract_job job;
+	job.reader = &reader;
+	job.dirName = dirName;
+	job.startOfEntries = startOfEntries;
+	job.index = &index;
+	job.mtime = file_mtime(packFileName);
+
+	unsigned numWorkers = pool_clamp_workers(g_jobs, numSelected);
+	uint64_t maxRunSize = PACK_RUN_MAX_SIZE;
+
+	// Make sure there are enough runs to keep every worker busy
+	if(numWorkers > 1) {
+		maxRunSize = min(maxRunSize, max((reader.size-startOfEntries)/(numWorkers*8), PACK_RUN_MAX_GAP));
+	}
+
+	// Read the entries in the order they are stored in, not in index order
+	if(!pack_plan_build(&job.plan, &index, selection, numSelected, startOfEntries, maxRunSize)) {
+		fatal("failed to plan PACK reads");
+	}
+
+	if(g_debug >= 1)
+	{
+		printf("Reading %"PRIuSZT" entries in %"PRIuSZT" runs\n",
+		    job.plan.numEntries, job.plan.numRuns);
+	}
+
+	numWorkers = pool_clamp_workers(numWorkers, job.plan.numRuns);
+	job.numWorkers = numWorkers;
+	job.workers = calloc(numWorkers, sizeof(struct extract_worker));
+
+	if(!job.workers) {
+		fatal("failed to allocate extraction workers");
+	}
+
+	// The first worker takes over the cursor we already have open, which is
+	// freed with the workers. The others only open their own handle when the
+	// pack isn't mapped.
+	job.workers[0].cursor = cursor;
+
+	unsigned w;
+	for(w = 1; w < numWorkers; w++) {
+		pack_cursor_init(&job.workers[w].cursor, &reader, NULL);
+	}
+
+	if(numWorkers > 1)
+	{
+		printf("Using %u worker threads\n", numWorkers);
+	}
+
+	bool useUring = false;
+
+	if(g_uring)
+	{
+#ifdef HAVE_URING
+		useUring = uring_supported();
+#endif
+
+		if(!useUring) {
+			warning("io_uring is not available, using regular I/O");
+		}
+	}
+
+	if(g_tarFd >= 0) {
+		extract_to_tar(&job, g_tarFd);
+	}
+#ifdef HAVE_URING
+	// Every worker runs its own ring over an interleaved share of the runs
+	else if(useUring) {
+		pool_run(numWorkers, numWorkers, extract_lane_uring, &job);
+	}
+#endif
+	else {
+		pool_run(numWorkers, job.plan.numRuns, extract_run, &job);
+	}
+
+	for(w = 0; w < numWorkers; w++) {
+		pack_cursor_free(&job.workers[w].cursor);
+		scratch_free(&job.workers[w].output);
+		scratch_free(&job.workers[w].batchOutput);
+	}
+
+	free(job.workers);
+	free(selection);
+	pack_plan_free(&job.plan);
+
+	// a lazily parsed index was only borrowed by `index`
+	if(lazy)
+		pack_index_lazy_free(&lazyIndex);
+	else
+		pack_index_free(&index);
+
+	scratch_free(&indexScratch);
+	free(dirName);
+	free(packBaseName);
+	pack_reader_close(&reader);
+
+	if(g_crcErrors > 0) {
+		fatal("%"PRIuSZT" objects failed their CRC-32 check", g_crcErrors);
+	}
+
+	return 0;
+}
+
+void extract_run(void * ctx, unsigned worker, size_t item)
+{
+	struct extract_job * job = ctx;
+	struct extract_worker * w = &job->workers[worker];
+	struct pack_run * run = &job->plan.runs[item];
+
+	// Every other worker is busy with one of the runs right after this one,
+	// so the run this worker is likely to pick up next is numWorkers away.
+	if(item+job->numWorkers < job->plan.numRuns) {
+		struct pack_run * next = &job->plan.runs[item+job->numWorkers];
+		pack_reader_advise(job->reader, next->offset, next->size);
+	}
+
+	// Lone entries are read directly so stored ones can still be copied by the kernel
+	if(run->count > 1 || job->reader->map) {
+		pack_cursor_prefetch(&w->cursor, run->offset, run->size);
+	}
+
+	// Neighbouring small entries are decoded together, see lzo1x_batch.h
+	size_t i = 0;
+	while(i < run->count) {
+		size_t n = extract_batch_size(job, w, run, i);
+
+		if(n > 1) {
+			extract_entry_batch(job, w, &job->plan.order[run->first+i], n);
+		} else {
+			extract_entry(job, w, job->plan.order[run->first+i]);
+			n = 1;
+		}
+
+		i += n;
+	}
+}
+
+void extract_entry(struct extract_job * job, struct extract_worker * w, size_t entry)
+{
+	struct pack_index_entry * e = &job->index->index[entry];
+
+	extract_print_entry(job->index, e, entry);
+
+	char * outName = w->outName;
+
+	if(snprintf(outName, EXTRACT_PATH_MAX, "./%s%s", job->dirName, pack_index_name(job->index, e)) >= EXTRACT_PATH_MAX) {
+		fatal("output path for %s is too long", pack_index_name(job->index, e));
+	}
+
+	if(e->compressedSize > 0) {
+		if(!carve_lzo_to_file(&w->cursor, job->index, e, e->offset+job->startOfEntries, e->compressedSize, outName, &w->output)) {
+			fatal("failed to unpack file %s", pack_index_name(job->index, e));
+		}
+	} else {
+		int fd = file_create(outName); // create a blank file
+
+		if(fd < 0) {
+			fatal("failed to open output file for writing");
+		}
+
+		close(fd);
+	}
+}
+
+// Small entries that actually need decoding
+bool entry_batchable(struct extract_job * job, size_t entry)
+{
+	struct pack_index_entry * e = &job->index->index[entry];
+
+	return e->compressedSize > 0 && e->decompressedSize <= LZO_OBJECT_BATCH_MAX_SIZE;
+}
+
+// Number of entries starting at `first` in the run that can be decoded as
+// one batch. They all have to be in memory at the same time.
+size_t extract_batch_size(struct extract_job * job, struct extract_worker * w, struct pack_run * run, size_t first)
+{
+	size_t n = 0;
+
+	while(first+n < run->count && n < LZO_OBJECT_BATCH_ENTRIES) {
+		size_t entry = job->plan.order[run->first+first+n];
+		struct pack_index_entry * e = &job->index->index[entry];
+
+		if(!entry_batchable(job, entry) ||
+		    !pack_cursor_resident(&w->cursor, job->startOfEntries+e->offset, e->compressedSize)) {
+			break;
+		}
+
+		n++;
+	}
+
+	return n;
+}
+
+// Small files gain nothing from kernel copies or mapped output, they are
+// simply written from the batch's buffer
+void extract_entry_batch(struct extract_job * job, struct extract_worker * w, const size_t * entries, size_t count)
+{
+	const uint8_t * data[LZO_OBJECT_BATCH_ENTRIES];
+	size_t sizes[LZO_OBJECT_BATCH_ENTRIES];
+
+	decode_entry_batch(job, &w->cursor, entries, count, &w->batchOutput, data, sizes);
+
+	size_t i;
+	for(i = 0; i < count; i++) {
+		struct pack_index_entry * e = &job->index->index[entries[i]];
+
+		extract_print_entry(job->index, e, entries[i]);
+
+		if(snprintf(w->outName, EXTRACT_PATH_MAX, "./%s%s", job->dirName, pack_index_name(job->index, e)) >= EXTRACT_PATH_MAX) {
+			fatal("output path for %s is too long", pack_index_name(job->index, e));
+		}
+
+		int outFile = file_create(w->outName);
+
+		if(outFile < 0) {
+			fatal("failed to open output file for writing");
+		}
+
+		if(!file_write_all(outFile, data[i], sizes[i])) {
+			fatal("failed to write all bytes to output file");
+		}
+
+		close(outFile);
+	}
+}
+
+// Decodes the objects of `count` entries, which must all be resident in the
+// cursor, in one batch. The results are kept in `out`, entry i's at data[i].
+void decode_entry_batch(struct extract_job * job, struct pack_cursor * c, const size_t * entries, size_t count,
+    struct scratch * out, const uint8_t ** data, size_t * sizes)
+{
+	struct lzo_object_decode_job jobs[LZO_OBJECT_BATCH_ENTRIES];
+	const uint8_t * objects[LZO_OBJECT_BATCH_ENTRIES];
+	uint32_t crcs[LZO_OBJECT_BATCH_ENTRIES];
+	size_t total = 0;
+	size_t i;
+
+	assert(count <= LZO_OBJECT_BATCH_ENTRIES);
+
+	for(i = 0; i < count; i++) {
+		struct pack_index_entry * e = &job->index->index[entries[i]];
+
+		objects[i] = pack_cursor_fetch(c, job->startOfEntries+e->offset, e->compressedSize);
+
+		if(!objects[i] || !lzo_object_parse(objects[i], e->compressedSize, &jobs[i].obj)) {
+			fatal("failed to unpack file %s", pack_index_name(job->index, e));
+		}
+
+		total += jobs[i].obj.decompressedSize;
+	}
+
+	// the object headers decide how much room there is, not the index
+	uint8_t * buf = scratch_reserve(out, total);
+
+	for(i = 0; i < count; i++) {
+		jobs[i].out = buf;
+		jobs[i].crc = g_checkCrc ? &crcs[i] : NULL;
+		crcs[i] = 0;
+		buf += jobs[i].obj.decompressedSize;
+	}
+
+	lzo_object_decode_batch(jobs, count);
+
+	for(i = 0; i < count; i++) {
+		struct pack_index_entry * e = &job->index->index[entries[i]];
+
+		pack_cursor_release(c, objects[i], job->startOfEntries+e->offset, e->compressedSize);
+
+		if(jobs[i].result != LZO_E_OK) {
+			printf("LZO: internal error - decompression failed: %d\n", jobs[i].result);
+			fatal("failed to unpack file %s", pack_index_name(job->index, e));
+		}
+
+		data[i] = jobs[i].out;
+		sizes[i] = jobs[i].outSize;
+
+		check_crc(job->index, e, job->startOfEntries+e->offset, jobs[i].obj.crc, crcs[i]);
+	}
+}
+
+void extract_print_entry(const struct pack_index * index, struct pack_index_entry * e, size_t entry)
+{
+	if(g_verbose >= 1)
+	{
+		printf("{%"PRIuSZT"} %30s (compressed size %u -> %u, offset %6u, CRC-32 0x%08x, U1 %u, U3 %u)\n",
+			entry+1, pack_index_name(index, e), e->compressedSize, e->decompressedSize,
+			e->offset,
+			e->crc,
+			e->unk1,
+			e->unk3);
+	}
+}
+
+void add_selection(const char * pattern)
+{
+	g_select = realloc(g_select, (g_numSelect+1)*sizeof(char *));
+	g_select[g_numSelect++] = strdup(pattern);
+}
+
+// Returns the index positions of every entry matching one of the selected
+// names or patterns. Plain names are looked up directly, only patterns need
+// to look at every entry. Selections matching nothing are reported.
+size_t * select_entries(struct pack_index * index, size_t * numSelected)
+{
+	bool * chosen = calloc(max(index->numEntries, 1), sizeof(bool));
+
+	if(!chosen) {
+		fatal("failed to allocate selection");
+	}
+
+	size_t i, j;
+	for(j = 0; j < g_numSelect; j++) {
+		bool matched = false;
+
+		if(!glob_has_wildcards(g_select[j])) {
+			size_t pos = pack_index_find(index, g_select[j], true);
+
+			if(pos != PACK_INDEX_NOT_FOUND) {
+				chosen[pos] = matched = true;
+			}
+		} else {
+			for(i = 0; i < index->numEntries; i++) {
+				if(glob_match(g_select[j], pack_index_name(index, &index->index[i]))) {
+					chosen[i] = matched = true;
+				}
+			}
+		}
+
+		if(!matched) {
+			warning("no entry matches '%s'", g_select[j]);
+		}
+	}
+
+	size_t * entries = malloc(max(index->numEntries, 1)*sizeof(size_t));
+	size_t num = 0;
+
+	if(!entries) {
+		fatal("failed to allocate selection");
+	}
+
+	for(i = 0; i < index->numEntries; i++) {
+		if(chosen[i]) {
+			entries[num++] = i;
+		}
+	}
+
+	free(chosen);
+
+	*numSelected = num;
+	return entries;
+}
+
+// True when entries were selected only by their exact names
+bool selection_exact()
+{
+	size_t j;
+
+	for(j = 0; j < g_numSelect; j++) {
+		if(glob_has_wildcards(g_select[j])) {
+			return false;
+		}
+	}
+
+	return g_numSelect > 0;
+}
+
+static int compare_positions(const void * a, const void * b)
+{
+	size_t l = *(const size_t *)a;
+	size_t r = *(const size_t *)b;
+
+	return l < r ? -1 : l > r;
+}
+
+// Like select_entries for exact names, but parses no more of the index than
+// it takes to find them
+size_t * select_entries_lazy(struct pack_index_lazy * lazy, size_t * numSelected)
+{
+	size_t * entries = malloc(g_numSelect*sizeof(size_t));
+	size_t num = 0;
+	size_t i, j;
+
+	if(!entries) {
+		fatal("failed to allocate selection");
+	}
+
+	for(j = 0; j < g_numSelect; j++) {
+		size_t pos = pack_index_lazy_find(lazy, g_select[j], true);
+
+		if(lazy->broken) {
+			fatal("failed to parse PACK index");
+		}
+
+		if(pos == PACK_INDEX_NOT_FOUND) {
+			warning("no entry matches '%s'", g_select[j]);
+		} else {
+			entries[num++] = pos;
+		}
+	}
+
+	// the same entry can be named more than once
+	qsort(entries, num, sizeof(size_t), compare_positions);
+
+	for(i = 0, j = 0; i < num; i++) {
+		if(j == 0 || entries[j-1] != entries[i]) {
+			entries[j++] = entries[i];
+		}
+	}
+
+	*numSelected = j;
+	return entries;
+}
+
+struct list_range
+{
+	size_t first;
+	size_t last;
+};
+
+static int compare_ranges(const void * a, const void * b)
+{
+	size_t l = ((const struct list_range *)a)->first;
+	size_t r = ((const struct list_range *)b)->first;
+
+	return l < r ? -1 : l > r;
+}
+
+// Marks every selection `name` matches, true when there is one
+static bool list_selected(const char * name, bool * matched)
+{
+	bool selected = g_numSelect == 0;
+	size_t j;
+
+	for(j = 0; j < g_numSelect; j++) {
+		if(glob_match(g_select[j], name)) {
+			matched[j] = selected = true;
+		}
+	}
+
+	return selected;
+}
+
+// Prints the selected entries, or all of them, in name order and returns how
+// many there were. A name or pattern only has to look at the names starting
+// with its part before the first wildcard, so listing a directory like
+// 'maps/*' takes O(log n + k) instead of a look at every entry.
+size_t list_entries(const struct pack_index * index, const struct pack_names * names)
+{
+	size_t numRanges = max(g_numSelect, 1);
+	struct list_range * ranges = malloc(numRanges*sizeof(*ranges));
+	bool * matched = calloc(numRanges, sizeof(bool));
+	size_t listed = 0, end = 0;
+	size_t j, r;
+
+	if(!ranges || !matched) {
+		fatal("failed to allocate selection");
+	}
+
+	ranges[0].first = 0;
+	ranges[0].last = names->numNames;
+
+	for(j = 0; j < g_numSelect; j++) {
+		size_t prefixLen = strcspn(g_select[j], "*?");
+		char * prefix = malloc(prefixLen+1);
+
+		if(!prefix) {
+			fatal("failed to allocate selection");
+		}
+
+		memcpy(prefix, g_select[j], prefixLen);
+		prefix[prefixLen] = '\0';
+
+		pack_names_range(names, prefix, &ranges[j].first, &ranges[j].last);
+		free(prefix);
+	}
+
+	qsort(ranges, numRanges, sizeof(*ranges), compare_ranges);
+
+	// where ranges overlap, the names are only walked once
+	for(r = 0; r < numRanges; r++) {
+		size_t first = max(ranges[r].first, end);
+		struct pack_names_iter it;
+
+		if(first >= ranges[r].last) {
+			continue;
+		}
+
+		pack_names_iter_init(&it, names, first);
+
+		while(it.rank < ranges[r].last && pack_names_next(&it)) {
+			if(!list_selected(it.name, matched)) {
+				continue;
+			}
+
+			const struct pack_index_entry * e = &index->index[it.entry];
+
+			if(g_verbose >= 1)
+				printf("%10"PRIu32" %10"PRIu32" 0x%08"PRIx32" %s\n", e->decompressedSize, e->compressedSize, e->crc, it.name);
+			else
+				printf("%10"PRIu32" %s\n", e->decompressedSize, it.name);
+
+			listed++;
+		}
+
+		pack_names_iter_free(&it);
+		end = ranges[r].last;
+	}
+
+	for(j = 0; j < g_numSelect; j++) {
+		if(!matched[j]) {
+			warning("no entry matches '%s'", g_select[j]);
+		}
+	}
+
+	free(ranges);
+	free(matched);
+
+	return listed;
+}
+
+// Writes every entry, in pack order, as one tar stream to `fd`
+void extract_to_tar(struct extract_job * job, int fd)
+{
+	struct tar_batch * batches = calloc(2, sizeof(struct tar_batch));
+	struct pool_task * writer = NULL;
+	size_t next = 0;
+	int cur = 0;
+
+	if(!batches) {
+		fatal("failed to allocate tar batches");
+	}
+
+	while(next < job->plan.numEntries)
+	{
+		struct tar_batch * batch = &batches[cur];
+		uint64_t bytes = 0;
+
+		batch->job = job;
+		batch->count = 0;
+
+		while(next < job->plan.numEntries && batch->count < TAR_BATCH_ENTRIES) {
+			size_t entry = job->plan.order[next];
+			uint32_t size = job->index->index[entry].decompressedSize;
+
+			if(batch->count > 0 && bytes+size > TAR_BATCH_BYTES) {
+				break;
+			}
+
+			batch->items[batch->count++].entry = entry;
+			bytes += size;
+			next++;
+		}
+
+		tar_group_batch(batch);
+		pool_run(job->numWorkers, batch->numGroups, tar_decode_group, batch);
+
+		// The other batch has to be written out before it can be refilled
+		if(writer) {
+			pool_wait(writer);
+		}
+
+		writer = pool_async(tar_write_batch, batch);
+		cur = !cur;
+	}
+
+	if(writer) {
+		pool_wait(writer);
+	}
+
+	if(!tar_write_end(fd)) {
+		fatal("failed to write tar stream");
+	}
+
+	int b;
+	size_t i;
+	for(b = 0; b < 2; b++) {
+		for(i = 0; i < TAR_BATCH_ENTRIES; i++) {
+			scratch_free(&batches[b].items[i].buf);
+		}
+	}
+
+	free(batches);
+}
+
+// Puts neighbouring small items in groups that are decoded together, while
+// still leaving a group for every worker
+void tar_group_batch(struct tar_batch * batch)
+{
+	struct extract_job * job = batch->job;
+	size_t maxGroup = min(max(batch->count/job->numWorkers, 2), LZO_OBJECT_BATCH_ENTRIES);
+	size_t i;
+
+	batch->numGroups = 0;
+
+	for(i = 0; i < batch->count; i++) {
+		size_t start = batch->numGroups > 0 ? batch->groups[batch->numGroups-1] : 0;
+
+		if(batch->numGroups == 0 || i-start >= maxGroup ||
+		    !entry_batchable(job, batch->items[i].entry) ||
+		    !entry_batchable(job, batch->items[start].entry)) {
+			batch->groups[batch->numGroups++] = i;
+		}
+	}
+
+	batch->groups[batch->numGroups] = batch->count;
+}
+
+void tar_decode_group(void * ctx, unsigned worker, size_t group)
+{
+	struct tar_batch * batch = ctx;
+	struct extract_job * job = batch->job;
+	struct pack_cursor * c = &job->workers[worker].cursor;
+	size_t first = batch->groups[group];
+	size_t count = batch->groups[group+1]-first;
+	size_t entries[LZO_OBJECT_BATCH_ENTRIES];
+	const uint8_t * data[LZO_OBJECT_BATCH_ENTRIES];
+	size_t sizes[LZO_OBJECT_BATCH_ENTRIES];
+	size_t i = 0;
+
+	if(count > 1) {
+		struct pack_index_entry * a = &job->index->index[batch->items[first].entry];
+		struct pack_index_entry * b = &job->index->index[batch->items[first+count-1].entry];
+		uint64_t start = job->startOfEntries+a->offset;
+		uint64_t end = job->startOfEntries+b->offset+b->compressedSize;
+
+		// the items are in pack order, so one read brings in all of them
+		if(end > start && end-start <= PACK_RUN_MAX_SIZE) {
+			pack_cursor_prefetch(c, start, end-start);
+		}
+
+		for(i = 0; i < count; i++) {
+			struct pack_index_entry * e = &job->index->index[batch->items[first+i].entry];
+
+			entries[i] = batch->items[first+i].entry;
+
+			if(!pack_cursor_resident(c, job->startOfEntries+e->offset, e->compressedSize)) {
+				break;
+			}
+		}
+	}
+
+	if(count < 2 || i < count) {
+		for(i = 0; i < count; i++) {
+			tar_decode_item(batch, worker, first+i);
+		}
+
+		return;
+	}
+
+	// the whole group is kept in its first item's buffer
+	decode_entry_batch(job, c, entries, count, &batch->items[first].buf, data, sizes);
+
+	for(i = 0; i < count; i++) {
+		batch->items[first+i].data = data[i];
+		batch->items[first+i].size = sizes[i];
+		batch->items[first+i].object = NULL;
+	}
+}
+
+void tar_decode_item(void * ctx, unsigned worker, size_t item)
+{
+	struct tar_batch * batch = ctx;
+	struct extract_job * job = batch->job;
+	struct pack_cursor * c = &job->workers[worker].cursor;
+	struct tar_item * it = &batch->items[item];
+	struct pack_index_entry * e = &job->index->index[it->entry];
+	uint64_t offset = job->startOfEntries+e->offset;
+
+	it->data = NULL;
+	it->size = 0;
+	it->object = NULL;
+
+	if(e->compressedSize == 0) {
+		return;
+	}
+
+	const uint8_t * data = pack_cursor_fetch(c, offset, e->compressedSize);
+	struct lzo_object obj;
+
+	if(!data || !lzo_object_parse(data, e->compressedSize, &obj)) {
+		fatal("failed to unpack file %s", pack_index_name(job->index, e));
+	}
+
+	// Stored entries in a mapped pack can be written straight from the
+	// mapping, which is released once they have been
+	if(obj.stored && job->reader->map && obj.payloadSize >= obj.decompressedSize) {
+		it->data = obj.payload;
+		it->size = obj.decompressedSize;
+		it->object = data;
+		it->objectOffset = offset;
+		it->objectSize = e->compressedSize;
+		check_crc_data(job->index, e, offset, obj.crc, it->data, it->size);
+		return;
+	}
+
+	uint32_t crc = 0;
+	int res = lzo_object_decode(&obj, scratch_reserve(&it->buf, obj.decompressedSize), &it->size,
+	    g_checkCrc ? &crc : NULL);
+
+	pack_cursor_release(c, data, offset, e->compressedSize);
+
+	if(res != LZO_E_OK) {
+		printf("LZO: internal error - decompression failed: %d\n", res);
+		fatal("failed to unpack file %s", pack_index_name(job->index, e));
+	}
+
+	it->data = it->buf.data;
+	check_crc(job->index, e, offset, obj.crc, crc);
+}
+
+void tar_write_batch(void * arg)
+{
+	struct tar_batch * batch = arg;
+	struct extract_job * job = batch->job;
+	size_t i;
+
+	for(i = 0; i < batch->count; i++) {
+		struct tar_item * it = &batch->items[i];
+		struct pack_index_entry * e = &job->index->index[it->entry];
+
+		extract_print_entry(job->index, e, it->entry);
+
+		if(!tar_write_header(g_tarFd, pack_index_name(job->index, e), it->size, job->mtime) ||
+		    !file_write_all(g_tarFd, it->data, it->size) ||
+		    !tar_write_padding(g_tarFd, it->size)) {
+			fatal("failed to write tar stream");
+		}
+
+		// releasing only touches the mapping, any worker's cursor will do
+		if(it->object) {
+			pack_cursor_release(&job->workers[0].cursor, it->object, it->objectOffset, it->objectSize);
+		}
+	}
+}
+
+#ifdef HAVE_URING
+// Extracts every numWorkers'th run starting at `lane`. Up to URING_DEPTH
+// entries are in flight at once, so the kernel reads the next entries and
+// writes out the previous ones while this thread decompresses.
+void extract_lane_uring(void * ctx, unsigned worker, size_t lane)
+{
+	struct extract_job * job = ctx;
+	struct uring ring;
+	struct uring_slot * slots = calloc(URING_DEPTH, sizeof(struct uring_slot));
+
+	if(!slots) {
+		fatal("failed to allocate io_uring slots");
+	}
+
+	if(!uring_init(&ring, URING_DEPTH)) {
+		fatal("failed to set up io_uring");
+	}
+
+	size_t run = lane;
+	size_t pos = 0;
+	unsigned busy = 0;
+
+	while(true)
+	{
+		unsigned i;
+
+		// Start reading as many entries as there are free slots
+		for(i = 0; i < URING_DEPTH; i++) {
+			if(slots[i].state != SLOT_FREE) {
+				continue;
+			}
+
+			while(run < job->plan.numRuns && pos >= job->plan.runs[run].count) {
+				run += job->numWorkers;
+				pos = 0;
+			}
+
+			if(run >= job->plan.numRuns) {
+				break;
+			}
+
+			uring_slot_start(job, &ring, &slots[i], i, job->plan.order[job->plan.runs[run].first+pos]);
+			pos++;
+			busy++;
+		}
+
+		if(busy == 0) {
+			break;
+		}
+
+		// Decompress one entry that has been read, then go back to the
+		// kernel without blocking. Only wait when there's nothing to do.
+		bool decoded = false;
+
+		for(i = 0; i < URING_DEPTH && !decoded; i++) {
+			if(slots[i].state == SLOT_READ) {
+				uring_slot_decode(job, &ring, &slots[i], i);
+				decoded = true;
+			}
+		}
+
+		if(uring_submit(&ring, decoded ? 0 : 1) < 0) {
+			fatal("io_uring submission failed");
+		}
+
+		struct io_uring_cqe * cqe;
+
+		while((cqe = uring_cqe(&ring))) {
+			unsigned idx = cqe->user_data;
+			int res = cqe->res;
+
+			uring_cqe_seen(&ring);
+			uring_slot_complete(job, &ring, &slots[idx], idx, res);
+
+			if(slots[idx].state == SLOT_FREE) {
+				busy--;
+			}
+		}
+	}
+
+	unsigned i;
+	for(i = 0; i < URING_DEPTH; i++) {
+		scratch_free(&slots[i].in);
+		scratch_free(&slots[i].out);
+	}
+
+	free(slots);
+	uring_free(&ring);
+}
+
+// There is never more than one operation per slot in flight and the ring has
+// a submission entry for every slot, so uring_sqe can't come back empty
+static struct io_uring_sqe * uring_slot_sqe(struct uring * u, unsigned idx, int opcode, int fd)
+{
+	struct io_uring_sqe * sqe = uring_sqe(u);
+
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->user_data = idx;
+
+	return sqe;
+}
+
+static void uring_slot_read(struct extract_job * job, struct uring * u, struct uring_slot * slot, unsigned idx)
+{
+	struct pack_index_entry * e = &job->index->index[slot->entry];
+	struct io_uring_sqe * sqe = uring_slot_sqe(u, idx, IORING_OP_READ, fileno(job->reader->fp));
+
+	sqe->addr = (uintptr_t)(slot->in.data+slot->done);
+	sqe->len = e->compressedSize-slot->done;
+	sqe->off = job->startOfEntries+e->offset+slot->done;
+
+	slot->state = SLOT_READING;
+}
+
+static void uring_slot_open(struct uring * u, struct uring_slot * slot, unsigned idx)
+{
+	struct io_uring_sqe * sqe = uring_slot_sqe(u, idx, IORING_OP_OPENAT, AT_FDCWD);
+
+	sqe->addr = (uintptr_t)slot->outName;
+	sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+	sqe->len = 0666;
+
+	slot->done = 0;
+	slot->state = SLOT_OPENING;
+}
+
+static void uring_slot_write(struct uring * u, struct uring_slot * slot, unsigned idx)
+{
+	struct io_uring_sqe * sqe = uring_slot_sqe(u, idx, IORING_OP_WRITE, slot->fd);
+
+	sqe->addr = (uintptr_t)(slot->data+slot->done);
+	sqe->len = min(slot->size-slot->done, 0x40000000);
+	sqe->off = slot->done;
+
+	slot->state = SLOT_WRITING;
+}
+
+static void uring_slot_close(struct uring * u, struct uring_slot * slot, unsigned idx)
+{
+	uring_slot_sqe(u, idx, IORING_OP_CLOSE, slot->fd);
+
+	slot->state = SLOT_CLOSING;
+}
+
+void uring_slot_start(struct extract_job * job, struct uring * u, struct uring_slot * slot, unsigned idx, size_t entry)
+{
+	struct pack_index_entry * e = &job->index->index[entry];
+
+	extract_print_entry(job->index, e, entry);
+
+	if(snprintf(slot->outName, EXTRACT_PATH_MAX, "./%s%s", job->dirName, pack_index_name(job->index, e)) >= EXTRACT_PATH_MAX) {
+		fatal("output path for %s is too long", pack_index_name(job->index, e));
+	}
+
+	slot->entry = entry;
+	slot->done = 0;
+
+	// empty entries go straight to creating a blank file
+	if(e->compressedSize == 0) {
+		slot->data = NULL;
+		slot->size = 0;
+		uring_slot_open(u, slot, idx);
+		return;
+	}
+
+	scratch_reserve(&slot->in, e->compressedSize);
+	uring_slot_read(job, u, slot, idx);
+}
+
+void uring_slot_decode(struct extract_job * job, struct uring * u, struct uring_slot * slot, unsigned idx)
+{
+	struct pack_index_entry * e = &job->index->index[slot->entry];
+	struct lzo_object obj;
+
+	if(!lzo_object_parse(slot->in.data, e->compressedSize, &obj)) {
+		fatal("failed to unpack file %s", pack_index_name(job->index, e));
+	}
+
+	if(obj.stored) {
+		if(obj.payloadSize < obj.decompressedSize) {
+			fatal("failed to unpack file %s", pack_index_name(job->index, e));
+		}
+
+		slot->data = obj.payload;
+		slot->size = obj.decompressedSize;
+		check_crc_data(job->index, e, job->startOfEntries+e->offset, obj.crc, slot->data, slot->size);
+	} else {
+		uint32_t crc = 0;
+		int res = lzo_object_decode(&obj, scratch_reserve(&slot->out, obj.decompressedSize), &slot->size,
+		    g_checkCrc ? &crc : NULL);
+
+		if(res != LZO_E_OK) {
+			printf("LZO: internal error - decompression failed: %d\n", res);
+			fatal("failed to unpack file %s", pack_index_name(job->index, e));
+		}
+
+		slot->data = slot->out.data;
+		check_crc(job->index, e, job->startOfEntries+e->offset, obj.crc, crc);
+	}
+
+	uring_slot_open(u, slot, idx);
+}
+
+void uring_slot_complete(struct extract_job * job, struct uring * u, struct uring_slot * slot, unsigned idx, int res)
+{
+	struct pack_index_entry * e = &job->index->index[slot->entry];
+
+	if(res < 0) {
+		fatal("I/O failed for %s: %s", pack_index_name(job->index, e), strerror(-res));
+	}
+
+	switch(slot->state)
+	{
+	case SLOT_READING:
+		if(res == 0) {
+			fatal("ran out of bytes when reading compressed data");
+		}
+
+		slot->done += res;
+
+		if(slot->done < e->compressedSize) {
+			uring_slot_read(job, u, slot, idx);
+		} else {
+			slot->state = SLOT_READ;
+		}
+		break;
+	case SLOT_OPENING:
+		slot->fd = res;
+
+		if(slot->size > 0) {
+			uring_slot_write(u, slot, idx);
+		} else {
+			uring_slot_close(u, slot, idx);
+		}
+		break;
+	case SLOT_WRITING:
+		if(res == 0) {
+			fatal("failed to write all bytes to output file");
+		}
+
+		slot->done += res;
+
+		if(slot->done < slot->size) {
+			uring_slot_write(u, slot, idx);
+		} else {
+			uring_slot_close(u, slot, idx);
+		}
+		break;
+	case SLOT_CLOSING:
+		slot->state = SLOT_FREE;
+		break;
+	default:
+		fatal("unexpected io_uring completion");
+		break;
+	}
+}
+#endif // HAVE_URING
+
+// Compares the CRC-32 of an object's contents, as taken while decoding it,
+// against its header and, for entries, the index. `e` is NULL for the index
+// itself. Mismatches are reported and counted, extraction goes on with the
+// other entries.
+bool check_crc(const struct pack_index * index, struct pack_index_entry * e, uint64_t offset, uint32_t objectCrc, uint32_t crc)
+{
+  if(!g_checkCrc)
+    return true;
+
+  const char * name = e ? pack_index_name(index, e) : "PACK index";
+
+  if(crc != objectCrc) {
+    warning("%s at 0x%"PRIx64": CRC-32 is 0x%08"PRIx32", the object header says 0x%08"PRIx32,
+        name, offset, crc, objectCrc);
+  } else if(e && crc != e->crc) {
+    warning("%s at 0x%"PRIx64": CRC-32 is 0x%08"PRIx32", the index says 0x%08"PRIx32,
+        name, offset, crc, e->crc);
+  } else {
+    return true;
+  }
+
+  __sync_fetch_and_add(&g_crcErrors, 1);
+  return false;
+}
+
+// For contents that didn't need decoding
+bool check_crc_data(const struct pack_index * index, struct pack_index_entry * e, uint64_t offset, uint32_t objectCrc, const uint8_t * data, size_t size)
+{
+  if(!g_checkCrc)
+    return true;
+
+  return check_crc(index, e, offset, objectCrc, crc32_update(0, data, size));
+}
+
+// Decompresses the object into `decompressed`, which is grown as needed and
+// can be reused for the next object. `e` is the entry the object belongs to,
+// NULL for the index.
+bool carve_lzo(struct pack_cursor * c, const struct pack_index * index, struct pack_index_entry * e, uint64_t offset, uint32_t compressedSize, struct scratch * decompressed, size_t * decompressedSize)
+{
+  // nothing to decompress, just skip the entry and signal an error
+  if(compressedSize == 0)
+  {
+    *decompressedSize = 0;
+    return false;
+  }
+
+  const uint8_t * data = pack_cursor_fetch(c, offset, compressedSize);
+
+  if(!data) {
+    fatal("ran out of bytes when reading compressed data");
+  }
+
+  struct lzo_object obj;
+
+  if(!lzo_object_parse(data, compressedSize, &obj)) {
+    fatal("LZO magic mismatch");
+  }
+
+  if(g_debug >= 1)
+  {
+	    printf("Extracting LZO object at 0x%"PRIx64" (compressed %"PRIu32"+12, decompressed %"PRIu32" %"PRIx32")\n",
+		offset, obj.payloadSize, obj.decompressedSize, obj.decompressedSize);
+  }
+
+  uint8_t * localDecompressed = scratch_reserve(decompressed, obj.decompressedSize);
+  size_t decompressedNewSize = 0;
+  uint32_t crc = 0;
+  int res = lzo_object_decode(&obj, localDecompressed, &decompressedNewSize, g_checkCrc ? &crc : NULL);
+
+  // we are done with the compressed bytes
+  pack_cursor_release(c, data, offset, compressedSize);
+
+  if (res == LZO_E_OK) {
+    *decompressedSize = decompressedNewSize;
+    check_crc(index, e, offset, obj.crc, crc);
+
+    return true;
+  }
+  else
+  {
+    printf("LZO: internal error - decompression failed: %d\n", res);
+
+    if(g_debug >= 1)
+	printf("newSize %"PRIuSZT", oldSize %u\n", decompressedNewSize, obj.decompressedSize);
+
+    return false;
+  }
 }
 
-bool carve_lzo_to_file(FILE * fp, const char * name, uint32_t compressedSize)
+bool carve_lzo_to_file(struct pack_cursor * c, const struct pack_index * index, struct pack_index_entry * e, uint64_t offset, uint32_t compressedSize, const char * name, struct scratch * decompressed)
 {
-  char * decompressed = NULL;
+  uint8_t head[LZO_OBJECT_HEADER_SIZE];
+  struct lzo_object obj;
+
+  if(!pack_cursor_read(c, offset, head, sizeof(head)) ||
+      !lzo_object_parse(head, compressedSize, &obj)) {
+    return false;
+  }
+
+  // Stored entries aren't decompressed, the kernel copies them from the pack.
+  // Even their CRC doesn't take more than looking at the mapped pages.
+  if(obj.stored) {
+    int outFile = file_create(name);
+
+    if(outFile < 0)
+      fatal("failed to open output file for writing");
+
+    if(obj.payloadSize < obj.decompressedSize) {
+      fatal("failed to copy stored entry to output file");
+    }
+
+    const uint8_t * payload = NULL;
+
+    // The CRC is taken over the mapping, whose pages the kernel then copies
+    // out of the page cache. Unmapped packs are read into the window for
+    // it, which pack_cursor_copy writes from instead of reading again.
+    if(g_checkCrc) {
+      payload = pack_cursor_fetch(c, offset+LZO_OBJECT_HEADER_SIZE, obj.decompressedSize);
+
+      if(!payload) {
+        fatal("ran out of bytes when reading compressed data");
+      }
+
+      check_crc_data(index, e, offset, obj.crc, payload, obj.decompressedSize);
+    }
+
+    if(!pack_cursor_copy(c, offset+LZO_OBJECT_HEADER_SIZE, obj.decompressedSize, outFile)) {
+      fatal("failed to copy stored entry to output file");
+    }
+
+    pack_cursor_release(c, payload, offset+LZO_OBJECT_HEADER_SIZE, obj.decompressedSize);
+
+    close(outFile);
+
+    return true;
+  }
+
+  // Decompress straight into the output file. The object header tells us
+  // exactly how big it is going to be.
+  if(g_mapOutput && obj.decompressedSize > 0) {
+    int outFile = file_create(name);
+
+    if(outFile < 0)
+      fatal("failed to open output file for writing");
+
+    bool ok = carve_lzo_to_mapped_file(c, index, e, offset, compressedSize, outFile, decompressed);
+
+    close(outFile);
+
+    return ok;
+  }
+
   size_t decompressedSize = 0;
 
-  if(!carve_lzo(fp, compressedSize, &decompressed, &decompressedSize))
+  if(!carve_lzo(c, index, e, offset, compressedSize, decompressed, &decompressedSize))
     return false;
 
-  FILE * outFile = fopen(name, "wb");
+  int outFile = file_create(name);
 
-  if(!outFile)
+  if(outFile < 0)
     fatal("failed to open output file for writing");
 
-  if(fwrite(decompressed, sizeof(char), decompressedSize, outFile) != decompressedSize) {
+  if(!file_write_all(outFile, decompressed->data, decompressedSize)) {
     fatal("failed to write all bytes to output file");
   }
 
-  fclose(outFile);
+  close(outFile);
+
+  return true;
+}
+
+// Returns false when the object fails to decompress. Files that can't be
+// mapped are written the usual way.
+bool carve_lzo_to_mapped_file(struct pack_cursor * c, const struct pack_index * index, struct pack_index_entry * e, uint64_t offset, uint32_t compressedSize, int outFile, struct scratch * decompressed)
+{
+  const uint8_t * data = pack_cursor_fetch(c, offset, compressedSize);
+  struct lzo_object obj;
+
+  if(!data) {
+    fatal("ran out of bytes when reading compressed data");
+  }
+
+  if(!lzo_object_parse(data, compressedSize, &obj)) {
+    fatal("LZO magic mismatch");
+  }
+
+  uint8_t * map = file_map_for_write(outFile, obj.decompressedSize);
+  size_t decompressedSize = 0;
+  uint32_t crc = 0;
+  int res;
+
+  if(map) {
+    res = lzo_object_decode(&obj, map, &decompressedSize, g_checkCrc ? &crc : NULL);
+
+    if(res == LZO_E_OK)
+      check_crc(index, e, offset, obj.crc, crc);
+
+    file_unmap(map, obj.decompressedSize);
+
+    // the object's header overstated its size, don't leave junk at the end
+    if(res == LZO_E_OK && decompressedSize != obj.decompressedSize && ftruncate(outFile, decompressedSize) != 0) {
+      fatal("failed to resize output file");
+    }
+  } else {
+    res = lzo_object_decode(&obj, scratch_reserve(decompressed, obj.decompressedSize), &decompressedSize,
+        g_checkCrc ? &crc : NULL);
+
+    if(res == LZO_E_OK) {
+      check_crc(index, e, offset, obj.crc, crc);
+
+      if(!file_write_all(outFile, decompressed->data, decompressedSize))
+        fatal("failed to write all bytes to output file");
+    }
+  }
+
+  pack_cursor_release(c, data, offset, compressedSize);
 
-  free(decompressed);
+  if(res != LZO_E_OK) {
+    printf("LZO: internal error - decompression failed: %d\n", res);
+    return false;
+  }
 
   return true;
 }
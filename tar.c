@@ -0,0 +1,117 @@
+#include "tar.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "fs.h"
+#include "util.h"
+
+struct tar_header
+{
+  char name[100];
+  char mode[8];
+  char uid[8];
+  char gid[8];
+  char size[12];
+  char mtime[12];
+  char chksum[8];
+  char typeflag;
+  char linkname[100];
+  char magic[6];
+  char version[2];
+  char uname[32];
+  char gname[32];
+  char devmajor[8];
+  char devminor[8];
+  char prefix[155];
+  char pad[12];
+};
+
+static const char tar_zeros[TAR_BLOCK_SIZE];
+
+static void tar_header_init(struct tar_header * h, const char * name, char type, uint64_t size, uint64_t mtime)
+{
+  memset(h, 0, sizeof(*h));
+
+  // the name field doesn't need to be terminated when it is completely full
+  memcpy(h->name, name, min(strlen(name), sizeof(h->name)));
+  snprintf(h->mode, sizeof(h->mode), "%07o", 0644);
+  snprintf(h->uid, sizeof(h->uid), "%07o", 0);
+  snprintf(h->gid, sizeof(h->gid), "%07o", 0);
+  snprintf(h->size, sizeof(h->size), "%011llo", (unsigned long long)size);
+  snprintf(h->mtime, sizeof(h->mtime), "%011llo", (unsigned long long)mtime);
+  h->typeflag = type;
+  memcpy(h->magic, "ustar", 6);
+  memcpy(h->version, "00", 2);
+
+  // the checksum is calculated with the checksum field itself set to spaces
+  memset(h->chksum, ' ', sizeof(h->chksum));
+
+  const unsigned char * bytes = (const unsigned char *)h;
+  unsigned sum = 0;
+  size_t i;
+
+  for(i = 0; i < sizeof(*h); i++)
+    sum += bytes[i];
+
+  snprintf(h->chksum, sizeof(h->chksum), "%06o", sum);
+  h->chksum[7] = ' ';
+}
+
+// Names that don't fit in the header get a pax extended header carrying the
+// full path in front of the real one
+static bool tar_write_long_name(int fd, const char * name, uint64_t mtime)
+{
+  char record[TAR_BLOCK_SIZE*8];
+  size_t nameLen = strlen(name);
+
+  // the record starts with its own length in decimal, including those digits
+  size_t len = nameLen+strlen(" path=\n");
+  size_t digits = 1;
+
+  while(snprintf(NULL, 0, "%"PRIuSZT, len+digits) != (int)digits)
+    digits++;
+
+  len += digits;
+
+  if(len >= sizeof(record))
+    return false;
+
+  snprintf(record, sizeof(record), "%"PRIuSZT" path=%s\n", len, name);
+
+  struct tar_header h;
+  tar_header_init(&h, "././@PaxHeader", 'x', len, mtime);
+
+  return file_write_all(fd, &h, sizeof(h)) &&
+    file_write_all(fd, record, len) &&
+    tar_write_padding(fd, len);
+}
+
+bool tar_write_header(int fd, const char * name, uint64_t size, uint64_t mtime)
+{
+  if(strlen(name) >= sizeof(((struct tar_header *)0)->name) && !tar_write_long_name(fd, name, mtime))
+    return false;
+
+  struct tar_header h;
+  tar_header_init(&h, name, '0', size, mtime);
+
+  return file_write_all(fd, &h, sizeof(h));
+}
+
+// Pads the data of a `size` byte file out to a whole block
+bool tar_write_padding(int fd, uint64_t size)
+{
+  size_t rem = size % TAR_BLOCK_SIZE;
+
+  if(rem == 0)
+    return true;
+
+  return file_write_all(fd, tar_zeros, TAR_BLOCK_SIZE-rem);
+}
+
+// An archive ends with two empty blocks
+bool tar_write_end(int fd)
+{
+  return file_write_all(fd, tar_zeros, TAR_BLOCK_SIZE) &&
+    file_write_all(fd, tar_zeros, TAR_BLOCK_SIZE);
+}
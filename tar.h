@@ -0,0 +1,15 @@
+#ifndef TAR_H
+#define TAR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Writes a POSIX (ustar) archive to a file descriptor, one regular file at a
+// time: a header, then the file's bytes, then padding.
+#define TAR_BLOCK_SIZE 512
+
+bool tar_write_header(int fd, const char * name, uint64_t size, uint64_t mtime);
+bool tar_write_padding(int fd, uint64_t size);
+bool tar_write_end(int fd);
+
+#endif
@@ -0,0 +1,160 @@
+#include "uring.h"
+
+#ifdef HAVE_URING
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// the operations extraction and packing rely on
+static const int uring_required_ops[] = {
+  IORING_OP_READ, IORING_OP_WRITE, IORING_OP_OPENAT, IORING_OP_CLOSE
+};
+
+static bool uring_probe(struct uring * u)
+{
+  size_t size = sizeof(struct io_uring_probe)+256*sizeof(struct io_uring_probe_op);
+  struct io_uring_probe * probe = calloc(1, size);
+
+  if(!probe)
+    return false;
+
+  bool ok = syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+
+  size_t i;
+  for(i = 0; ok && i < sizeof(uring_required_ops)/sizeof(*uring_required_ops); i++) {
+    int op = uring_required_ops[i];
+
+    if(op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+      ok = false;
+  }
+
+  free(probe);
+
+  return ok;
+}
+
+bool uring_init(struct uring * u, unsigned entries)
+{
+  struct io_uring_params p;
+
+  memset(u, 0, sizeof(*u));
+  memset(&p, 0, sizeof(p));
+
+  u->fd = syscall(__NR_io_uring_setup, entries, &p);
+
+  if(u->fd < 0)
+    return false;
+
+  u->sqRingSize = p.sq_off.array+p.sq_entries*sizeof(unsigned);
+  u->cqRingSize = p.cq_off.cqes+p.cq_entries*sizeof(struct io_uring_cqe);
+  u->sqesSize = p.sq_entries*sizeof(struct io_uring_sqe);
+
+  u->sqRing = mmap(NULL, u->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+  u->cqRing = mmap(NULL, u->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+  u->sqes = mmap(NULL, u->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+
+  if(u->sqRing == MAP_FAILED || u->cqRing == MAP_FAILED || u->sqes == MAP_FAILED || !uring_probe(u)) {
+    uring_free(u);
+    return false;
+  }
+
+  u->sqHead = (unsigned *)((char *)u->sqRing+p.sq_off.head);
+  u->sqTail = (unsigned *)((char *)u->sqRing+p.sq_off.tail);
+  u->sqMask = (unsigned *)((char *)u->sqRing+p.sq_off.ring_mask);
+  u->sqArray = (unsigned *)((char *)u->sqRing+p.sq_off.array);
+
+  u->cqHead = (unsigned *)((char *)u->cqRing+p.cq_off.head);
+  u->cqTail = (unsigned *)((char *)u->cqRing+p.cq_off.tail);
+  u->cqMask = (unsigned *)((char *)u->cqRing+p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe *)((char *)u->cqRing+p.cq_off.cqes);
+
+  return true;
+}
+
+void uring_free(struct uring * u)
+{
+  if(u->sqes && u->sqes != MAP_FAILED)
+    munmap(u->sqes, u->sqesSize);
+
+  if(u->cqRing && u->cqRing != MAP_FAILED)
+    munmap(u->cqRing, u->cqRingSize);
+
+  if(u->sqRing && u->sqRing != MAP_FAILED)
+    munmap(u->sqRing, u->sqRingSize);
+
+  if(u->fd >= 0)
+    close(u->fd);
+
+  memset(u, 0, sizeof(*u));
+  u->fd = -1;
+}
+
+// Whether this kernel lets us set up a ring at all (it may be too old, or
+// io_uring may be disabled by policy)
+bool uring_supported()
+{
+  struct uring u;
+
+  if(!uring_init(&u, 2))
+    return false;
+
+  uring_free(&u);
+
+  return true;
+}
+
+// Returns a cleared submission entry to fill in, or NULL when the queue is full
+struct io_uring_sqe * uring_sqe(struct uring * u)
+{
+  unsigned head = __atomic_load_n(u->sqHead, __ATOMIC_ACQUIRE);
+  unsigned tail = *u->sqTail+u->sqPending;
+
+  if(tail-head > *u->sqMask)
+    return NULL;
+
+  unsigned idx = tail & *u->sqMask;
+  struct io_uring_sqe * sqe = &u->sqes[idx];
+
+  memset(sqe, 0, sizeof(*sqe));
+  u->sqArray[idx] = idx;
+  u->sqPending++;
+
+  return sqe;
+}
+
+// Hands every entry returned by uring_sqe to the kernel and optionally waits
+// for `waitFor` completions. Returns the io_uring_enter result.
+int uring_submit(struct uring * u, unsigned waitFor)
+{
+  unsigned submit = u->sqPending;
+
+  __atomic_store_n(u->sqTail, *u->sqTail+submit, __ATOMIC_RELEASE);
+  u->sqPending = 0;
+
+  if(submit == 0 && waitFor == 0)
+    return 0;
+
+  return syscall(__NR_io_uring_enter, u->fd, submit, waitFor,
+      waitFor ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+// Returns the oldest completion without waiting, or NULL if there is none
+struct io_uring_cqe * uring_cqe(struct uring * u)
+{
+  unsigned head = *u->cqHead;
+
+  if(head == __atomic_load_n(u->cqTail, __ATOMIC_ACQUIRE))
+    return NULL;
+
+  return &u->cqes[head & *u->cqMask];
+}
+
+void uring_cqe_seen(struct uring * u)
+{
+  __atomic_store_n(u->cqHead, *u->cqHead+1, __ATOMIC_RELEASE);
+}
+
+#endif // HAVE_URING
@@ -0,0 +1,55 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "compat.h"
+
+// io_uring is only used when the kernel headers are new enough to know about
+// the open/close opcodes (5.7+)
+#if defined(PLATFORM_LINUX) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#    include <linux/io_uring.h>
+#    ifdef IORING_FEAT_FAST_POLL
+#      define HAVE_URING
+#    endif
+#  endif
+#endif
+
+#ifdef HAVE_URING
+
+// A minimal io_uring on top of the raw system calls
+struct uring
+{
+  int fd;
+
+  void * sqRing;
+  size_t sqRingSize;
+  unsigned * sqHead;
+  unsigned * sqTail;
+  unsigned * sqMask;
+  unsigned * sqArray;
+  struct io_uring_sqe * sqes;
+  size_t sqesSize;
+  unsigned sqPending;
+
+  void * cqRing;
+  size_t cqRingSize;
+  unsigned * cqHead;
+  unsigned * cqTail;
+  unsigned * cqMask;
+  struct io_uring_cqe * cqes;
+};
+
+bool uring_init(struct uring * u, unsigned entries);
+void uring_free(struct uring * u);
+bool uring_supported();
+struct io_uring_sqe * uring_sqe(struct uring * u);
+int uring_submit(struct uring * u, unsigned waitFor);
+struct io_uring_cqe * uring_cqe(struct uring * u);
+void uring_cqe_seen(struct uring * u);
+
+#endif // HAVE_URING
+
+#endif
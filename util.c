@@ -2,11 +2,18 @@
 
 #include "fs.h"
 
+#include <ctype.h>
 #include <stdarg.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 void fatal(char * msg, ...)
 {
   va_list list;
@@ -91,3 +98,82 @@ char * get_extension(char * path)
 
     return ptr;
 }
+
+// Matches `name` against a shell style pattern where * matches any run of
+// characters and ? any single one. Case is ignored, just like the game does.
+bool glob_match(const char * pattern, const char * name)
+{
+  const char * star = NULL;
+  const char * retry = NULL;
+
+  while(*name) {
+    if(*pattern == '*') {
+      // remember where to resume if the rest doesn't match
+      star = ++pattern;
+      retry = name;
+    } else if(*pattern == '?' || tolower((unsigned char)*pattern) == tolower((unsigned char)*name)) {
+      pattern++;
+      name++;
+    } else if(star) {
+      // let the last star swallow one more character
+      pattern = star;
+      name = ++retry;
+    } else {
+      return false;
+    }
+  }
+
+  while(*pattern == '*')
+    pattern++;
+
+  return *pattern == '\0';
+}
+
+bool glob_has_wildcards(const char * pattern)
+{
+  return strpbrk(pattern, "*?") != NULL;
+}
+
+uint8_t * scratch_reserve(struct scratch * s, size_t size)
+{
+  if(size <= s->size && s->data)
+    return s->data;
+
+  // the old contents aren't needed, so skip the copy realloc would do
+  free(s->data);
+
+  s->data = malloc(max(size, 1));
+  s->size = size;
+
+  if(!s->data)
+    fatal("failed to allocate %"PRIuSZT" bytes of scratch memory", size);
+
+  return s->data;
+}
+
+void scratch_free(struct scratch * s)
+{
+  free(s->data);
+
+  s->data = NULL;
+  s->size = 0;
+}
+
+// Seconds on a monotonic clock, for measuring how long something took
+double time_seconds()
+{
+#ifdef PLATFORM_WINDOWS
+  LARGE_INTEGER freq, now;
+
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+
+  return (double)now.QuadPart/freq.QuadPart;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec/1e9;
+#endif
+}
@@ -2,6 +2,7 @@
 #define UTIL_H
 
 #include <stdbool.h>
+#include <stdlib.h>
 #include <inttypes.h>
 
 #include "compat.h"
@@ -25,6 +26,20 @@ void warning(char * msg, ...) PRINTF_FMT;
 char * basename(const char * path, bool extension);
 char * string_cat(const char * l, const char * r);
 char * get_extension(char * path);
+bool glob_match(const char * pattern, const char * name);
+bool glob_has_wildcards(const char * pattern);
+double time_seconds();
+
+// A heap buffer that only ever grows. Reusing one for every entry keeps the
+// allocator out of the per-entry path.
+struct scratch
+{
+  uint8_t * data;
+  size_t size;
+};
+
+uint8_t * scratch_reserve(struct scratch * s, size_t size);
+void scratch_free(struct scratch * s);
 
 #define min(x, y) (((x) < (y)) ? (x) : (y))
 #define max(x, y) (((x) < (y)) ? (y) : (x))
@@ -0,0 +1,360 @@
+#include "verify.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "minilzo.h"
+#include "util.h"
+#include "pool.h"
+#include "pack.h"
+#include "index.h"
+#include "crc32.h"
+
+// Longest description of a single problem
+#define VERIFY_MESSAGE_MAX 256
+
+// Every worker decodes into its own buffer and keeps its own counts, they
+// are only added up at the end
+struct verify_worker
+{
+  struct pack_cursor cursor;
+  struct scratch output;
+  size_t entries;
+  size_t problems;
+  uint64_t compressedBytes;
+  uint64_t decompressedBytes;
+};
+
+struct verify_job
+{
+  const struct verify_options * opts;
+  struct pack_reader * reader;
+  struct pack_index * index;
+  uint64_t startOfEntries;
+  struct pack_plan plan;
+  struct verify_worker * workers;
+  unsigned numWorkers;
+};
+
+static void verify_problem(struct verify_worker * w, const char * name, uint64_t offset, const char * msg, ...)
+{
+  char text[VERIFY_MESSAGE_MAX];
+  va_list list;
+
+  va_start(list, msg);
+  vsnprintf(text, sizeof(text), msg, list);
+  va_end(list);
+
+  warning("%s at 0x%"PRIx64": %s", name, offset, text);
+  w->problems++;
+}
+
+// Checks what decoding the object of `e` gave. `crc` was taken while decoding.
+static void verify_result(struct verify_job * job, struct verify_worker * w, struct pack_index_entry * e,
+    const struct lzo_object * obj, int res, size_t size, uint32_t crc)
+{
+  const char * name = pack_index_name(job->index, e);
+  uint64_t offset = job->startOfEntries+e->offset;
+  size_t problems = w->problems;
+
+  w->decompressedBytes += size;
+
+  if(res != LZO_E_OK) {
+    verify_problem(w, name, offset, "decompression failed with LZO error %d", res);
+    return;
+  }
+
+  if(size != e->decompressedSize) {
+    verify_problem(w, name, offset, "decompressed to %"PRIuSZT" bytes, the index says %"PRIu32,
+        size, e->decompressedSize);
+  }
+
+  if(crc != obj->crc) {
+    verify_problem(w, name, offset, "CRC-32 is 0x%08"PRIx32", the object header says 0x%08"PRIx32,
+        crc, obj->crc);
+  } else if(crc != e->crc) {
+    verify_problem(w, name, offset, "CRC-32 is 0x%08"PRIx32", the index says 0x%08"PRIx32,
+        crc, e->crc);
+  }
+
+  if(job->opts->verbose >= 1 && w->problems == problems)
+    printf("%30s ok (%"PRIuSZT" bytes, CRC-32 0x%08"PRIx32")\n", name, size, crc);
+}
+
+// Returns the entry's object, or NULL when there is nothing to decode or the
+// object is broken
+static const uint8_t * verify_fetch(struct verify_job * job, struct verify_worker * w, struct pack_index_entry * e,
+    struct lzo_object * obj)
+{
+  const char * name = pack_index_name(job->index, e);
+  uint64_t offset = job->startOfEntries+e->offset;
+
+  w->entries++;
+
+  // an empty file
+  if(e->compressedSize == 0)
+    return NULL;
+
+  const uint8_t * data = pack_cursor_fetch(&w->cursor, offset, e->compressedSize);
+
+  if(!data) {
+    verify_problem(w, name, offset, "the object's %"PRIu32" bytes go past the end of the pack", e->compressedSize);
+    return NULL;
+  }
+
+  w->compressedBytes += e->compressedSize;
+
+  if(!lzo_object_parse(data, e->compressedSize, obj)) {
+    verify_problem(w, name, offset, "the object header is broken");
+    pack_cursor_release(&w->cursor, data, offset, e->compressedSize);
+    return NULL;
+  }
+
+  return data;
+}
+
+static void verify_entry(struct verify_job * job, struct verify_worker * w, size_t entry)
+{
+  struct pack_index_entry * e = &job->index->index[entry];
+  struct lzo_object obj;
+  const uint8_t * data = verify_fetch(job, w, e, &obj);
+  size_t size = 0;
+  uint32_t crc = 0;
+  int res;
+
+  if(!data)
+    return;
+
+  // stored objects need no copy, their CRC is taken right where they are
+  if(obj.stored) {
+    size = min(obj.payloadSize, obj.decompressedSize);
+    crc = crc32_update(0, obj.payload, size);
+    res = size == obj.decompressedSize ? LZO_E_OK : LZO_E_INPUT_OVERRUN;
+  } else {
+    res = lzo_object_decode(&obj, scratch_reserve(&w->output, obj.decompressedSize), &size, &crc);
+  }
+
+  pack_cursor_release(&w->cursor, data, job->startOfEntries+e->offset, e->compressedSize);
+
+  verify_result(job, w, e, &obj, res, size, crc);
+}
+
+// Decodes neighbouring small entries together, see lzo1x_batch.h
+static void verify_batch(struct verify_job * job, struct verify_worker * w, const size_t * entries, size_t count)
+{
+  struct lzo_object_decode_job jobs[LZO_OBJECT_BATCH_ENTRIES];
+  const uint8_t * objects[LZO_OBJECT_BATCH_ENTRIES];
+  struct pack_index_entry * batchEntries[LZO_OBJECT_BATCH_ENTRIES];
+  uint32_t crcs[LZO_OBJECT_BATCH_ENTRIES];
+  size_t num = 0, total = 0, i;
+
+  for(i = 0; i < count; i++) {
+    struct pack_index_entry * e = &job->index->index[entries[i]];
+
+    objects[num] = verify_fetch(job, w, e, &jobs[num].obj);
+
+    if(objects[num]) {
+      batchEntries[num] = e;
+      total += jobs[num].obj.decompressedSize;
+      num++;
+    }
+  }
+
+  uint8_t * buf = scratch_reserve(&w->output, total);
+
+  for(i = 0; i < num; i++) {
+    jobs[i].out = buf;
+    jobs[i].crc = &crcs[i];
+    crcs[i] = 0;
+    buf += jobs[i].obj.decompressedSize;
+  }
+
+  lzo_object_decode_batch(jobs, num);
+
+  for(i = 0; i < num; i++) {
+    struct pack_index_entry * e = batchEntries[i];
+
+    pack_cursor_release(&w->cursor, objects[i], job->startOfEntries+e->offset, e->compressedSize);
+    verify_result(job, w, e, &jobs[i].obj, jobs[i].result, jobs[i].outSize, crcs[i]);
+  }
+}
+
+static void verify_run(void * ctx, unsigned worker, size_t item)
+{
+  struct verify_job * job = ctx;
+  struct verify_worker * w = &job->workers[worker];
+  struct pack_run * run = &job->plan.runs[item];
+  size_t i = 0;
+
+  if(item+job->numWorkers < job->plan.numRuns) {
+    struct pack_run * next = &job->plan.runs[item+job->numWorkers];
+    pack_reader_advise(job->reader, next->offset, next->size);
+  }
+
+  pack_cursor_prefetch(&w->cursor, run->offset, run->size);
+
+  while(i < run->count) {
+    size_t n = 0;
+
+    while(i+n < run->count && n < LZO_OBJECT_BATCH_ENTRIES) {
+      struct pack_index_entry * e = &job->index->index[job->plan.order[run->first+i+n]];
+
+      if(e->compressedSize == 0 || e->decompressedSize > LZO_OBJECT_BATCH_MAX_SIZE ||
+          !pack_cursor_resident(&w->cursor, job->startOfEntries+e->offset, e->compressedSize)) {
+        break;
+      }
+
+      n++;
+    }
+
+    if(n > 1) {
+      verify_batch(job, w, &job->plan.order[run->first+i], n);
+    } else {
+      verify_entry(job, w, job->plan.order[run->first+i]);
+      n = 1;
+    }
+
+    i += n;
+  }
+}
+
+static void verify_print_summary(const char * packPath, struct verify_job * job, double seconds)
+{
+  size_t entries = 0, problems = 0;
+  uint64_t compressed = 0, decompressed = 0;
+  unsigned i;
+
+  for(i = 0; i < job->numWorkers; i++) {
+    entries += job->workers[i].entries;
+    problems += job->workers[i].problems;
+    compressed += job->workers[i].compressedBytes;
+    decompressed += job->workers[i].decompressedBytes;
+  }
+
+  seconds = max(seconds, 1e-6);
+
+  printf("Verified %"PRIuSZT" files of %s in %.2f s: read %.1f MB (%.1f MB/s), decompressed %.1f MB (%.1f MB/s)\n",
+      entries, packPath, seconds,
+      compressed/1e6, compressed/1e6/seconds,
+      decompressed/1e6, decompressed/1e6/seconds);
+
+  if(problems > 0)
+    printf("%s%"PRIuSZT" problems found%s\n", AC_RED, problems, AC_RESET);
+  else
+    printf("%sNo problems found%s\n", AC_GREEN, AC_RESET);
+}
+
+bool verify_pack(const char * packPath, const struct verify_options * opts)
+{
+  struct verify_job job;
+  struct verify_worker indexWorker;
+  struct pack_reader reader;
+  struct pack_header header;
+  struct pack_index index;
+  struct scratch indexData = {NULL, 0};
+  double start = time_seconds();
+  unsigned i;
+
+  memset(&job, 0, sizeof(job));
+  memset(&indexWorker, 0, sizeof(indexWorker));
+  job.opts = opts;
+
+  if(lzo_init() != LZO_E_OK) {
+    fatal("failed to initialize LZO");
+  }
+
+  if(!pack_reader_open(&reader, packPath)) {
+    fatal("could not open '%s' for reading", packPath);
+  }
+
+  pack_cursor_init(&indexWorker.cursor, &reader, reader.fp);
+
+  if(!pack_cursor_read(&indexWorker.cursor, 0, &header, sizeof(header)) ||
+      memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC))) {
+    fatal("%s is not a pack", packPath);
+  }
+
+  // Nothing else can be checked without the index
+  const uint8_t * object = pack_cursor_fetch(&indexWorker.cursor, sizeof(header), header.compressed_index_size);
+  struct lzo_object obj;
+  size_t indexSize = 0;
+  uint32_t crc = 0;
+
+  if(!object || !lzo_object_parse(object, header.compressed_index_size, &obj) ||
+      lzo_object_decode(&obj, scratch_reserve(&indexData, obj.decompressedSize), &indexSize, &crc) != LZO_E_OK ||
+      !pack_index_parse((char *)indexData.data, indexSize, &index, opts->jobs)) {
+    fatal("failed to read the index of %s", packPath);
+  }
+
+  if(crc != obj.crc) {
+    verify_problem(&indexWorker, "PACK index", sizeof(header),
+        "CRC-32 is 0x%08"PRIx32", the object header says 0x%08"PRIx32, crc, obj.crc);
+  }
+
+  if(indexSize != header.decompressed_index_size) {
+    verify_problem(&indexWorker, "PACK index", sizeof(header),
+        "decompressed to %"PRIuSZT" bytes, the header says %"PRIu32, indexSize, header.decompressed_index_size);
+  }
+
+  if(index.numEntries != header.num_files) {
+    verify_problem(&indexWorker, "PACK index", sizeof(header),
+        "has %"PRIuSZT" files, the header says %"PRIu32, index.numEntries, header.num_files);
+  }
+
+  job.reader = &reader;
+  job.index = &index;
+  job.startOfEntries = sizeof(header)+header.compressed_index_size;
+
+  unsigned numWorkers = pool_clamp_workers(opts->jobs, index.numEntries);
+  uint64_t maxRunSize = PACK_RUN_MAX_SIZE;
+
+  // enough runs to keep every worker busy, as when extracting
+  if(numWorkers > 1 && reader.size > job.startOfEntries) {
+    maxRunSize = min(maxRunSize, max((reader.size-job.startOfEntries)/(numWorkers*8), PACK_RUN_MAX_GAP));
+  }
+
+  if(!pack_plan_build(&job.plan, &index, NULL, index.numEntries, job.startOfEntries, maxRunSize)) {
+    fatal("failed to plan PACK reads");
+  }
+
+  job.numWorkers = pool_clamp_workers(numWorkers, job.plan.numRuns);
+  job.workers = calloc(job.numWorkers, sizeof(struct verify_worker));
+
+  if(!job.workers) {
+    fatal("failed to allocate verification workers");
+  }
+
+  // the first worker takes over the cursor the index was read with
+  job.workers[0] = indexWorker;
+
+  for(i = 1; i < job.numWorkers; i++) {
+    pack_cursor_init(&job.workers[i].cursor, &reader, NULL);
+  }
+
+  printf("Verifying %"PRIuSZT" files in %s\n", index.numEntries, packPath);
+
+  if(job.numWorkers > 1) {
+    printf("Using %u worker threads\n", job.numWorkers);
+  }
+
+  pool_run(job.numWorkers, job.plan.numRuns, verify_run, &job);
+
+  verify_print_summary(packPath, &job, time_seconds()-start);
+
+  size_t problems = 0;
+
+  for(i = 0; i < job.numWorkers; i++) {
+    problems += job.workers[i].problems;
+    pack_cursor_free(&job.workers[i].cursor);
+    scratch_free(&job.workers[i].output);
+  }
+
+  free(job.workers);
+  pack_plan_free(&job.plan);
+  pack_index_free(&index);
+  scratch_free(&indexData);
+  pack_reader_close(&reader);
+
+  return problems == 0;
+}
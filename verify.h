@@ -0,0 +1,17 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stdbool.h>
+
+struct verify_options
+{
+  unsigned jobs; // worker threads, 0 for one per CPU
+  int verbose;
+};
+
+// Decodes every entry of a pack in memory and checks it against its object
+// header and the index, without writing anything. Problems are reported as
+// they are found. Returns true when there were none.
+bool verify_pack(const char * packPath, const struct verify_options * opts);
+
+#endif